@@ -0,0 +1,62 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __ANALYZE__CPP__
+#define __ANALYZE__CPP__
+
+
+#include "samples.h"
+#include "trace.h"
+
+#include <iostream>
+#include <set>
+#include <string>
+
+using std::cout;
+using std::cerr;
+
+
+// ~ Prints latency percentiles (in nanoseconds) of the samples of each test of a raw samples file
+// Usage: analyze <samples file> [test]
+// The samples are streamed from the mapped file, so files larger than memory are processed.
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <samples file> [test]\n";
+        return 1;
+    }
+    try {
+        TSampleReader reader(argv[1]);
+        std::set<ui32> tests;
+        for (const auto& run : reader.GetRuns())
+            tests.insert(run.Test);
+        if (argc > 2)
+            tests = {static_cast<ui32>(std::stoul(argv[2]))};
+
+        cout << reader.GetDescription();
+        cout << "test,op,count,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,p9999_ns,max_ns\n";
+        const std::pair<ui32, const char*> ops[] = {{~0u, "all"},
+                                                    {static_cast<ui32>(ETraceOp::Read), "read"},
+                                                    {static_cast<ui32>(ETraceOp::Write), "write"}};
+        for (ui32 test : tests) {
+            for (auto [op, name] : ops) {
+                TSampleReader::TFilter filter;
+                filter.Test = test;
+                filter.Op = op;
+                THistogram latencies = reader.Latencies(filter);
+                if (latencies.GetCount() == 0)
+                    continue;
+                cout << test << "," << name << "," << latencies.GetCount() << ","
+                     << latencies.Statistics().first << ","
+                     << latencies.Percentile(50) << "," << latencies.Percentile(90) << ","
+                     << latencies.Percentile(99) << "," << latencies.Percentile(99.9) << ","
+                     << latencies.Percentile(99.99) << "," << latencies.GetMax() << "\n";
+            }
+        }
+    } catch (const std::exception& e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+
+#endif
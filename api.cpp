@@ -6,52 +6,184 @@
 
 #include "api.h"
 
-#include <sys/types.h> // lseek()
-#include <sys/uio.h> // readv(), writev()
-#include <unistd.h> // pread(), pwrite()
-
-using Nhrc = std::chrono::high_resolution_clock;
+#include <sys/types.h>
+#include <sys/uio.h> // preadv(), pwritev()
+#include <unistd.h> // pread(), pwrite(), syscall()
+#include <sys/mman.h> // mmap(), munmap(), madvise(), msync()
+#include <sys/stat.h> // fstat()
+#include <cerrno> // errno
+#include <cstring> // memset(), strerror()
+#include <stdexcept> // runtime_error
+#include <string> // std::to_string()
+#include <algorithm> // std::max(), std::min()
 
+#if defined (__linux__)
+#include <sys/syscall.h> // __NR_io_uring_*, __NR_io_*
+#include <sys/vfs.h> // fstatfs()
+#include <linux/magic.h> // TMPFS_MAGIC
+#endif
 
 // ~ IAPI batch operations with time measurement
 std::pair<ssize_t, ui64> IAPI::Read(int fd, const std::vector<void*>& bufs, size_t count, const std::vector<off_t>& offsets) {
     auto start = Nhrc::now();
     ssize_t bytesProcessed = 0;
-    for (ui32 i = 0; i < bufs.size(); i++)
-        bytesProcessed += pread(fd, bufs[i], count, offsets[i]);
+    for (ui32 i = 0; i < bufs.size(); i++) {
+        if (!OpLatencies) {
+            bytesProcessed += Completed(pread(fd, bufs[i], count, offsets[i]));
+            continue;
+        }
+        auto opStart = Nhrc::now();
+        bytesProcessed += Completed(pread(fd, bufs[i], count, offsets[i]));
+        RecordOp(OpStart(i, opStart), Nhrc::now(), offsets[i], true);
+    }
     auto end = Nhrc::now();
-    return {bytesProcessed, Duration(start, end)};
+    return {bytesProcessed, BatchLatency(start, end)};
 }
 
 std::pair<ssize_t, ui64> IAPI::Write(int fd, const std::vector<void*>& bufs, size_t count, const std::vector<off_t>& offsets) {
     auto start = Nhrc::now();
     ssize_t bytesProcessed = 0;
-    for (ui32 i = 0; i < bufs.size(); i++)
-        bytesProcessed += pwrite(fd, bufs[i], count, offsets[i]);
+    for (ui32 i = 0; i < bufs.size(); i++) {
+        if (!OpLatencies) {
+            bytesProcessed += Completed(pwrite(fd, bufs[i], count, offsets[i]));
+            continue;
+        }
+        auto opStart = Nhrc::now();
+        bytesProcessed += Completed(pwrite(fd, bufs[i], count, offsets[i]));
+        RecordOp(OpStart(i, opStart), Nhrc::now(), offsets[i], false);
+    }
     auto end = Nhrc::now();
-    return {bytesProcessed, Duration(start, end)};
+    return {bytesProcessed, BatchLatency(start, end)};
 }
 
 std::pair<ssize_t, ui64> IAPI::Read(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets) {
     auto start = Nhrc::now();
     ssize_t bytesProcessed = 0;
-    for (ui32 i = 0; i < iovs.size(); i++)
-        bytesProcessed += preadv(fd, iovs[i], iovcnt, offsets[i]);
+    for (ui32 i = 0; i < iovs.size(); i++) {
+        if (!OpLatencies) {
+            bytesProcessed += Completed(preadv(fd, iovs[i], iovcnt, offsets[i]));
+            continue;
+        }
+        auto opStart = Nhrc::now();
+        bytesProcessed += Completed(preadv(fd, iovs[i], iovcnt, offsets[i]));
+        RecordOp(OpStart(i, opStart), Nhrc::now(), offsets[i], true);
+    }
     auto end = Nhrc::now();
-    return {bytesProcessed, Duration(start, end)};
+    return {bytesProcessed, BatchLatency(start, end)};
 }
 
 std::pair<ssize_t, ui64> IAPI::Write(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets) {
     auto start = Nhrc::now();
     ssize_t bytesProcessed = 0;
-    for (ui32 i = 0; i < iovs.size(); i++)
-        bytesProcessed += pwritev(fd, iovs[i], iovcnt, offsets[i]);
+    for (ui32 i = 0; i < iovs.size(); i++) {
+        if (!OpLatencies) {
+            bytesProcessed += Completed(pwritev(fd, iovs[i], iovcnt, offsets[i]));
+            continue;
+        }
+        auto opStart = Nhrc::now();
+        bytesProcessed += Completed(pwritev(fd, iovs[i], iovcnt, offsets[i]));
+        RecordOp(OpStart(i, opStart), Nhrc::now(), offsets[i], false);
+    }
     auto end = Nhrc::now();
-    return {bytesProcessed, Duration(start, end)};
+    return {bytesProcessed, BatchLatency(start, end)};
+}
+
+std::pair<ssize_t, ui64> IAPI::ReadWrite(int fd, const std::vector<void*>& bufs, const std::vector<size_t>& counts, const std::vector<off_t>& offsets, const std::vector<char>& isRead) {
+    bool homogeneous = true;
+    for (ui32 i = 1; i < bufs.size(); i++)
+        homogeneous &= (isRead[i] == isRead[0] && counts[i] == counts[0]);
+    if (homogeneous && !bufs.empty())
+        return (isRead[0] ? Read(fd, bufs, counts[0], offsets) : Write(fd, bufs, counts[0], offsets));
+
+    auto start = Nhrc::now();
+    ssize_t bytesProcessed = 0;
+    for (ui32 i = 0; i < bufs.size(); i++) {
+        auto opStart = Nhrc::now();
+        if (isRead[i])
+            bytesProcessed += Completed(pread(fd, bufs[i], counts[i], offsets[i]));
+        else
+            bytesProcessed += Completed(pwrite(fd, bufs[i], counts[i], offsets[i]));
+        if (OpLatencies)
+            RecordOp(OpStart(i, opStart), Nhrc::now(), offsets[i], isRead[i]);
+    }
+    auto end = Nhrc::now();
+    return {bytesProcessed, BatchLatency(start, end)};
+}
+
+std::pair<ssize_t, ui64> IAPI::ReadWrite(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets, const std::vector<char>& isRead) {
+    bool homogeneous = true;
+    for (ui32 i = 1; i < iovs.size(); i++)
+        homogeneous &= (isRead[i] == isRead[0]);
+    if (homogeneous && !iovs.empty())
+        return (isRead[0] ? Read(fd, iovs, iovcnt, offsets) : Write(fd, iovs, iovcnt, offsets));
+
+    auto start = Nhrc::now();
+    ssize_t bytesProcessed = 0;
+    for (ui32 i = 0; i < iovs.size(); i++) {
+        auto opStart = Nhrc::now();
+        if (isRead[i])
+            bytesProcessed += Completed(preadv(fd, iovs[i], iovcnt, offsets[i]));
+        else
+            bytesProcessed += Completed(pwritev(fd, iovs[i], iovcnt, offsets[i]));
+        if (OpLatencies)
+            RecordOp(OpStart(i, opStart), Nhrc::now(), offsets[i], isRead[i]);
+    }
+    auto end = Nhrc::now();
+    return {bytesProcessed, BatchLatency(start, end)};
+}
+
+
+void IAPI::ThrowOpError() {
+    throw std::runtime_error(std::string("ReadWrite() error: ") + strerror(errno));
+}
+
+void IAPI::SetOpLatencies(THistogram* opLatencies) {
+    OpLatencies = opLatencies;
+}
+
+void IAPI::SetSamples(TSampleStream* samples) {
+    Samples = samples;
+}
+
+void IAPI::SetIntendedStarts(const std::vector<TTimePoint>* intendedStarts) {
+    IntendedStarts = intendedStarts;
+}
+
+ui64 IAPI::GetWouldBlock() const {
+    return WouldBlock;
+}
+
+ui64 IAPI::GetBusyTime() const {
+    return BusyTime;
+}
+
+
+std::unique_ptr<IAPIFactory> CreateAPIFactory(EEngine engine) {
+    switch (engine) {
+    case EEngine::Posix:
+        return std::unique_ptr<IAPIFactory>(new TAPIFactory<TPosixAPI>());
+    case EEngine::Mmap:
+        return std::unique_ptr<IAPIFactory>(new TAPIFactory<TMmapAPI>());
+    case EEngine::Null:
+        return std::unique_ptr<IAPIFactory>(new TAPIFactory<TNullAPI>());
+    #if defined (__linux__)
+    case EEngine::IoUring:
+        return std::unique_ptr<IAPIFactory>(new TAPIFactory<TIoUringAPI>());
+    case EEngine::LinuxAio:
+        return std::unique_ptr<IAPIFactory>(new TAPIFactory<TLinuxAioAPI>());
+    case EEngine::Preadv2:
+        return std::unique_ptr<IAPIFactory>(new TAPIFactory<TPreadv2API>());
+    #endif
+    default:
+        break;
+    }
+    throw std::runtime_error("CreateAPIFactory() error: engine " +
+                             std::to_string((ui64)engine) + " not supported");
 }
 
 
 // ~ TPosixAPI base operations
+// All the operations are positional, so the workers sharing the descriptor do not move each other's offsets.
 ssize_t TPosixAPI::pread(int fd, void* buf, size_t count, off_t offset) {
     return ::pread(fd, buf, count, offset);
 }
@@ -61,13 +193,603 @@ ssize_t TPosixAPI::pwrite(int fd, const void *buf, size_t count, off_t offset) {
 }
 
 ssize_t TPosixAPI::preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
-    lseek(fd, offset, SEEK_SET);
-    return ::readv(fd, iov, iovcnt);
+    return ::preadv(fd, iov, iovcnt, offset);
 }
 
 ssize_t TPosixAPI::pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
-    lseek(fd, offset, SEEK_SET);
-    return ::writev(fd, iov, iovcnt);
+    return ::pwritev(fd, iov, iovcnt, offset);
+}
+
+
+#if defined (__linux__)
+// ~ TPreadv2API
+void TPreadv2API::Setup(int fd, const struct iovec& buffers, const TEngineParams& params) {
+    ReadFlags = (params.HighPriority ? RWF_HIPRI : 0) | (params.NoWait ? RWF_NOWAIT : 0);
+    WriteFlags = (params.HighPriority ? RWF_HIPRI : 0) | (params.DSync ? RWF_DSYNC : 0)
+                 | (params.Append ? RWF_APPEND : 0);
+}
+
+ssize_t TPreadv2API::pread(int fd, void* buf, size_t count, off_t offset) {
+    struct iovec iov = {buf, count};
+    return preadv(fd, &iov, 1, offset);
+}
+
+ssize_t TPreadv2API::pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    struct iovec iov = {const_cast<void*>(buf), count};
+    return pwritev(fd, &iov, 1, offset);
+}
+
+ssize_t TPreadv2API::preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+    ssize_t result = ::preadv2(fd, iov, iovcnt, offset, ReadFlags);
+    if (result == -1 && errno == EAGAIN && (ReadFlags & RWF_NOWAIT)) {
+        WouldBlock++;
+        result = ::preadv2(fd, iov, iovcnt, offset, ReadFlags & ~RWF_NOWAIT);
+    }
+    return result;
+}
+
+ssize_t TPreadv2API::pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+    return ::pwritev2(fd, iov, iovcnt, offset, WriteFlags);
+}
+#endif
+
+
+// ~ TMmapAPI
+TMmapAPI::~TMmapAPI() {
+    Release();
+}
+
+void TMmapAPI::Setup(int fd, const struct iovec& buffers, const TEngineParams& params) {
+    Release();
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0)
+        throw std::runtime_error("TMmapAPI::Setup() error: cannot map an empty file");
+
+    int flags = MAP_SHARED;
+    #if defined (__linux__)
+    if (params.MapPopulate)
+        flags |= MAP_POPULATE;
+    #endif
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error(std::string("TMmapAPI::Setup() mmap() error: ") + strerror(errno));
+    Mapping = static_cast<char*>(mapping);
+    MappingSize = st.st_size;
+    MapSync = params.MapSync;
+
+    int advice = MADV_NORMAL;
+    switch (static_cast<EMapAdvice>(params.MapAdvice)) {
+    case EMapAdvice::Normal:
+        break;
+    case EMapAdvice::Sequential:
+        advice = MADV_SEQUENTIAL;
+        break;
+    case EMapAdvice::Random:
+        advice = MADV_RANDOM;
+        break;
+    case EMapAdvice::WillNeed:
+        advice = MADV_WILLNEED;
+        break;
+    default:
+        throw std::runtime_error("TMmapAPI::Setup() error: advice " + std::to_string(params.MapAdvice) +
+                                 " not supported");
+    }
+    if (madvise(Mapping, MappingSize, advice) == -1)
+        throw std::runtime_error(std::string("TMmapAPI::Setup() madvise() error: ") + strerror(errno));
+
+    #if defined (__linux__)
+    // Transparent huge pages back the page cache of tmpfs (and shmem) only, MADV_HUGEPAGE on a
+    // mapping of an ext4 or xfs file is accepted and ignored, so the level would measure the baseline.
+    if (params.MapHugePages) {
+        struct statfs fs;
+        if (fstatfs(fd, &fs) == -1 || fs.f_type != TMPFS_MAGIC)
+            throw std::runtime_error("TMmapAPI::Setup() error: MAPHUGE = 1 requires the file on tmpfs");
+        if (madvise(Mapping, MappingSize, MADV_HUGEPAGE) == -1)
+            throw std::runtime_error(std::string("TMmapAPI::Setup() huge pages madvise() error: ") + strerror(errno));
+    }
+    #endif
+}
+
+void TMmapAPI::Release() {
+    if (Mapping)
+        munmap(Mapping, MappingSize);
+    Mapping = nullptr;
+    MappingSize = 0;
+}
+
+size_t TMmapAPI::Available(size_t count, off_t offset) const {
+    if (offset >= (off_t)MappingSize)
+        return 0;
+    return std::min<size_t>(count, MappingSize - offset);
+}
+
+void TMmapAPI::Sync(off_t offset, size_t count) const {
+    if (!MapSync || count == 0)
+        return;
+    // msync() requires a page-aligned address.
+    off_t pageSize = sysconf(_SC_PAGESIZE);
+    off_t start = offset - offset % pageSize;
+    msync(Mapping + start, offset + count - start, MS_SYNC);
+}
+
+ssize_t TMmapAPI::pread(int fd, void* buf, size_t count, off_t offset) {
+    if (!Mapping)
+        return ::pread(fd, buf, count, offset);
+    count = Available(count, offset);
+    memcpy(buf, Mapping + offset, count);
+    return count;
+}
+
+ssize_t TMmapAPI::pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    if (!Mapping)
+        return ::pwrite(fd, buf, count, offset);
+    count = Available(count, offset);
+    memcpy(Mapping + offset, buf, count);
+    Sync(offset, count);
+    return count;
+}
+
+ssize_t TMmapAPI::preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+    if (!Mapping)
+        return ::preadv(fd, iov, iovcnt, offset);
+    ssize_t bytesProcessed = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        size_t count = Available(iov[i].iov_len, offset + bytesProcessed);
+        memcpy(iov[i].iov_base, Mapping + offset + bytesProcessed, count);
+        bytesProcessed += count;
+    }
+    return bytesProcessed;
+}
+
+ssize_t TMmapAPI::pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+    if (!Mapping)
+        return ::pwritev(fd, iov, iovcnt, offset);
+    ssize_t bytesProcessed = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        size_t count = Available(iov[i].iov_len, offset + bytesProcessed);
+        memcpy(Mapping + offset + bytesProcessed, iov[i].iov_base, count);
+        bytesProcessed += count;
+    }
+    Sync(offset, bytesProcessed);
+    return bytesProcessed;
+}
+
+
+// ~ TAsyncAPI batch and base operations
+std::pair<ssize_t, ui64> TAsyncAPI::Read(int fd, const std::vector<void*>& bufs, size_t count, const std::vector<off_t>& offsets) {
+    Requests.clear();
+    for (ui32 i = 0; i < bufs.size(); i++)
+        Requests.push_back({bufs[i], count, offsets[i], true, i});
+    return Execute(fd, BufferDepth);
+}
+
+std::pair<ssize_t, ui64> TAsyncAPI::Write(int fd, const std::vector<void*>& bufs, size_t count, const std::vector<off_t>& offsets) {
+    Requests.clear();
+    for (ui32 i = 0; i < bufs.size(); i++)
+        Requests.push_back({bufs[i], count, offsets[i], false, i});
+    return Execute(fd, BufferDepth);
+}
+
+std::pair<ssize_t, ui64> TAsyncAPI::Read(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets) {
+    SplitIovs(iovs, iovcnt, offsets, nullptr, true);
+    return Execute(fd, iovcnt);
+}
+
+std::pair<ssize_t, ui64> TAsyncAPI::Write(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets) {
+    SplitIovs(iovs, iovcnt, offsets, nullptr, false);
+    return Execute(fd, iovcnt);
+}
+
+std::pair<ssize_t, ui64> TAsyncAPI::ReadWrite(int fd, const std::vector<void*>& bufs, const std::vector<size_t>& counts, const std::vector<off_t>& offsets, const std::vector<char>& isRead) {
+    Requests.clear();
+    for (ui32 i = 0; i < bufs.size(); i++)
+        Requests.push_back({bufs[i], counts[i], offsets[i], (bool)isRead[i], i});
+    return Execute(fd, BufferDepth);
+}
+
+std::pair<ssize_t, ui64> TAsyncAPI::ReadWrite(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets, const std::vector<char>& isRead) {
+    SplitIovs(iovs, iovcnt, offsets, &isRead, true);
+    return Execute(fd, iovcnt);
+}
+
+ssize_t TAsyncAPI::pread(int fd, void* buf, size_t count, off_t offset) {
+    Requests.clear();
+    Requests.push_back({buf, count, offset, true, 0});
+    return Execute(fd, 1).first;
+}
+
+ssize_t TAsyncAPI::pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    Requests.clear();
+    Requests.push_back({const_cast<void*>(buf), count, offset, false, 0});
+    return Execute(fd, 1).first;
+}
+
+ssize_t TAsyncAPI::preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+    SplitIovs({iov}, iovcnt, {offset}, nullptr, true);
+    return Execute(fd, iovcnt).first;
+}
+
+ssize_t TAsyncAPI::pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+    SplitIovs({iov}, iovcnt, {offset}, nullptr, false);
+    return Execute(fd, iovcnt).first;
 }
 
+void TAsyncAPI::SplitIovs(const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets,
+                          const std::vector<char>* isRead, bool allRead) {
+    Requests.clear();
+    for (ui32 i = 0; i < iovs.size(); i++) {
+        bool read = (isRead ? (*isRead)[i] : allRead);
+        // Buffers of a vectored operation are laid out in the file one after another.
+        off_t offset = offsets[i];
+        for (int j = 0; j < iovcnt; j++) {
+            Requests.push_back({iovs[i][j].iov_base, iovs[i][j].iov_len, offset, read, i});
+            offset += iovs[i][j].iov_len;
+        }
+    }
+}
+
+
+#if defined (__linux__)
+// ~ TIoUringAPI
+// The ring is driven through raw syscalls, so no liburing is required.
+static int IoUringSetup(unsigned entries, struct io_uring_params* params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int IoUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int IoUringRegister(int ringFd, unsigned opcode, const void* arg, unsigned nrArgs) {
+    return syscall(__NR_io_uring_register, ringFd, opcode, arg, nrArgs);
+}
+
+
+TIoUringAPI::~TIoUringAPI() {
+    DestroyRing();
+}
+
+void TIoUringAPI::Setup(int fd, const struct iovec& buffers, const TEngineParams& params) {
+    if (params.IoPoll && !params.DirectIO)
+        throw std::runtime_error("TIoUringAPI::Setup() error: IOPOLL requires DirectIO = 1");
+    DestroyRing();
+    Params = params;
+    RegisteredFd = (params.FixedFiles ? fd : -1);
+    RegisteredBuffers = (params.FixedBuffers ? buffers : iovec{nullptr, 0});
+    BufferDepth = std::max<ui32>(params.QueueDepth, 1);
+    SetupRing(params.QueueDepth);
+}
+
+void TIoUringAPI::Release() {
+    DestroyRing();
+    Params = TEngineParams();
+    RegisteredFd = -1;
+    RegisteredBuffers = {nullptr, 0};
+    BufferDepth = 1;
+}
+
+bool TIoUringAPI::IsRegistered(const TRequest& request) const {
+    char* begin = static_cast<char*>(RegisteredBuffers.iov_base);
+    char* buf = static_cast<char*>(request.Buf);
+    return begin && buf >= begin && buf + request.Count <= begin + RegisteredBuffers.iov_len;
+}
+
+void TIoUringAPI::SetupRing(ui32 depth) {
+    if (RingFd != -1 && Entries >= depth)
+        return;
+    DestroyRing();
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    if (Params.SqPoll) {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = 1000; // ms
+    }
+    if (Params.IoPoll)
+        params.flags |= IORING_SETUP_IOPOLL;
+    if ((RingFd = IoUringSetup(depth, &params)) < 0) {
+        RingFd = -1;
+        throw std::runtime_error(std::string("io_uring_setup() error: ") + strerror(errno));
+    }
+    Entries = params.sq_entries;
+
+    SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        SqRingSize = CqRingSize = std::max(SqRingSize, CqRingSize);
+    SqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    SqRing = mmap(nullptr, SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_SQ_RING);
+    if (SqRing == MAP_FAILED) {
+        SqRing = nullptr;
+        DestroyRing();
+        throw std::runtime_error("io_uring submission ring mmap() error");
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        CqRing = SqRing;
+    } else {
+        CqRing = mmap(nullptr, CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_CQ_RING);
+        if (CqRing == MAP_FAILED) {
+            CqRing = nullptr;
+            DestroyRing();
+            throw std::runtime_error("io_uring completion ring mmap() error");
+        }
+    }
+    void* sqes = mmap(nullptr, SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        DestroyRing();
+        throw std::runtime_error("io_uring submission entries mmap() error");
+    }
+    Sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(SqRing);
+    SqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    SqFlags = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+    SqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    SqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(CqRing);
+    CqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    CqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    CqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    Cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Registrations are made once per ring, so requests skip per-call fd lookup and page pinning.
+    if (RegisteredFd != -1 && IoUringRegister(RingFd, IORING_REGISTER_FILES, &RegisteredFd, 1) < 0) {
+        DestroyRing();
+        throw std::runtime_error(std::string("io_uring file registration error: ") + strerror(errno));
+    }
+    if (RegisteredBuffers.iov_base && IoUringRegister(RingFd, IORING_REGISTER_BUFFERS, &RegisteredBuffers, 1) < 0) {
+        DestroyRing();
+        throw std::runtime_error(std::string("io_uring buffers registration error: ") + strerror(errno));
+    }
+
+    SlotStarts.resize(Entries);
+    SlotRequests.resize(Entries);
+    FreeSlots.clear();
+    for (ui32 i = 0; i < Entries; i++)
+        FreeSlots.push_back(i);
+}
+
+void TIoUringAPI::DestroyRing() {
+    if (Sqes)
+        munmap(Sqes, SqesSize);
+    if (CqRing && CqRing != SqRing)
+        munmap(CqRing, CqRingSize);
+    if (SqRing)
+        munmap(SqRing, SqRingSize);
+    if (RingFd != -1)
+        close(RingFd);
+    Sqes = nullptr;
+    SqRing = CqRing = nullptr;
+    RingFd = -1;
+    Entries = 0;
+}
+
+std::pair<ssize_t, ui64> TIoUringAPI::Execute(int fd, ui32 depth) {
+    SetupRing(depth);
+
+    auto start = Nhrc::now();
+    ssize_t bytesProcessed = 0;
+    ui64 next = 0; // ~ Index of the next request to be queued
+    ui64 completed = 0;
+    ui32 inFlight = 0;
+    ui32 unsubmitted = 0; // ~ Queued requests not yet consumed by the kernel
+    while (completed < Requests.size()) {
+        // Refill the submission queue up to the queue depth.
+        unsigned tail = *SqTail;
+        auto submitTime = Nhrc::now();
+        while (inFlight < depth && next < Requests.size()) {
+            const TRequest& request = Requests[next];
+            ui32 slot = FreeSlots.back();
+            FreeSlots.pop_back();
+            SlotStarts[slot] = OpStart(request.Op, submitTime);
+            SlotRequests[slot] = next;
+
+            unsigned index = tail & *SqMask;
+            struct io_uring_sqe* sqe = &Sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = (request.IsRead ? IORING_OP_READ : IORING_OP_WRITE);
+            sqe->fd = fd;
+            sqe->addr = reinterpret_cast<ui64>(request.Buf);
+            sqe->len = request.Count;
+            sqe->off = request.Offset;
+            sqe->user_data = slot;
+            if (fd == RegisteredFd) {
+                sqe->fd = 0; // ~ Index in the registered files table
+                sqe->flags |= IOSQE_FIXED_FILE;
+            }
+            if (IsRegistered(request)) {
+                sqe->opcode = (request.IsRead ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED);
+                sqe->buf_index = 0;
+            }
+            SqArray[index] = index;
+
+            tail++;
+            next++;
+            inFlight++;
+            unsubmitted++;
+        }
+        __atomic_store_n(SqTail, tail, __ATOMIC_RELEASE);
+
+        // Submit the queued requests and wait for at least one completion.
+        // With SQPOLL the kernel thread consumes the queue itself and is only woken up if idle.
+        unsigned enterFlags = IORING_ENTER_GETEVENTS;
+        if (Params.SqPoll) {
+            if (__atomic_load_n(SqFlags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)
+                enterFlags |= IORING_ENTER_SQ_WAKEUP;
+            unsubmitted = 0;
+        }
+        int submitted = IoUringEnter(RingFd, unsubmitted, 1, enterFlags);
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+            throw std::runtime_error(std::string("io_uring_enter() error: ") + strerror(errno));
+        }
+        unsubmitted -= std::min<ui32>(unsubmitted, submitted);
+
+        // Reap all the available completions.
+        unsigned head = *CqHead;
+        unsigned cqTail = __atomic_load_n(CqTail, __ATOMIC_ACQUIRE);
+        auto completionTime = Nhrc::now();
+        while (head != cqTail) {
+            const struct io_uring_cqe& cqe = Cqes[head & *CqMask];
+            ui32 slot = cqe.user_data;
+            if (cqe.res < 0)
+                throw std::runtime_error(std::string("io_uring request error: ") + strerror(-cqe.res));
+            bytesProcessed += cqe.res;
+            if (OpLatencies)
+                RecordOp(SlotStarts[slot], completionTime, Requests[SlotRequests[slot]].Offset, Requests[SlotRequests[slot]].IsRead);
+            FreeSlots.push_back(slot);
+            head++;
+            inFlight--;
+            completed++;
+        }
+        __atomic_store_n(CqHead, head, __ATOMIC_RELEASE);
+    }
+    auto end = Nhrc::now();
+    return {bytesProcessed, BatchLatency(start, end)};
+}
+
+
+// ~ TLinuxAioAPI
+// Kernel AIO is driven through raw syscalls, so no libaio is required.
+static int IoSetup(unsigned nrEvents, aio_context_t* context) {
+    return syscall(__NR_io_setup, nrEvents, context);
+}
+
+static int IoDestroy(aio_context_t context) {
+    return syscall(__NR_io_destroy, context);
+}
+
+static int IoSubmit(aio_context_t context, long nr, struct iocb** iocbs) {
+    return syscall(__NR_io_submit, context, nr, iocbs);
+}
+
+static int IoGetEvents(aio_context_t context, long minNr, long nr, struct io_event* events) {
+    return syscall(__NR_io_getevents, context, minNr, nr, events, nullptr);
+}
+
+
+TLinuxAioAPI::~TLinuxAioAPI() {
+    DestroyContext();
+}
+
+void TLinuxAioAPI::Setup(int fd, const struct iovec& buffers, const TEngineParams& params) {
+    if (!params.DirectIO)
+        throw std::runtime_error("TLinuxAioAPI::Setup() error: Linux AIO requires DirectIO = 1, "
+                                 "buffered files are processed synchronously");
+    BufferDepth = std::max<ui32>(params.QueueDepth, 1);
+    SetupContext(params.QueueDepth);
+}
+
+void TLinuxAioAPI::Release() {
+    DestroyContext();
+    BufferDepth = 1;
+}
+
+void TLinuxAioAPI::SetupContext(ui32 depth) {
+    if (Context != 0 && Slots >= depth)
+        return;
+    DestroyContext();
+
+    if (IoSetup(depth, &Context) < 0) {
+        Context = 0;
+        throw std::runtime_error(std::string("io_setup() error: ") + strerror(errno));
+    }
+    Slots = depth;
+
+    Iocbs.assign(Slots, iocb());
+    Pending.reserve(Slots);
+    Events.resize(Slots);
+    SlotStarts.resize(Slots);
+    SlotRequests.resize(Slots);
+    FreeSlots.clear();
+    for (ui32 i = 0; i < Slots; i++)
+        FreeSlots.push_back(i);
+}
+
+void TLinuxAioAPI::DestroyContext() {
+    if (Context != 0)
+        IoDestroy(Context);
+    Context = 0;
+    Slots = 0;
+}
+
+std::pair<ssize_t, ui64> TLinuxAioAPI::Execute(int fd, ui32 depth) {
+    SetupContext(depth);
+
+    auto start = Nhrc::now();
+    ssize_t bytesProcessed = 0;
+    ui64 next = 0; // ~ Index of the next request to be submitted
+    ui64 completed = 0;
+    ui32 inFlight = 0;
+    while (completed < Requests.size()) {
+        // Prepare control blocks up to the queue depth.
+        Pending.clear();
+        while (inFlight + Pending.size() < depth && next < Requests.size()) {
+            const TRequest& request = Requests[next];
+            ui32 slot = FreeSlots.back();
+            FreeSlots.pop_back();
+
+            struct iocb& cb = Iocbs[slot];
+            memset(&cb, 0, sizeof(cb));
+            cb.aio_lio_opcode = (request.IsRead ? IOCB_CMD_PREAD : IOCB_CMD_PWRITE);
+            cb.aio_fildes = fd;
+            cb.aio_buf = reinterpret_cast<ui64>(request.Buf);
+            cb.aio_nbytes = request.Count;
+            cb.aio_offset = request.Offset;
+            cb.aio_data = slot;
+            // The submission time is taken into account below.
+            SlotStarts[slot] = OpStart(request.Op, TTimePoint::max());
+            SlotRequests[slot] = next;
+            Pending.push_back(&cb);
+            next++;
+        }
+
+        // Submit the whole group, io_submit() may take only a part of it.
+        auto submitTime = Nhrc::now();
+        for (ui32 i = 0; i < Pending.size(); i++) {
+            TTimePoint& start = SlotStarts[Pending[i]->aio_data];
+            start = std::min(start, submitTime);
+        }
+        ui32 submitted = 0;
+        while (submitted < Pending.size()) {
+            int result = IoSubmit(Context, Pending.size() - submitted, Pending.data() + submitted);
+            if (result < 0) {
+                if (errno == EINTR || errno == EAGAIN)
+                    continue;
+                throw std::runtime_error(std::string("io_submit() error: ") + strerror(errno));
+            }
+            // No request accepted and no error reported would retry forever.
+            if (result == 0)
+                throw std::runtime_error("io_submit() error: no request was accepted");
+            submitted += result;
+        }
+        inFlight += submitted;
+
+        // Wait for at least one completion and reap all the available ones.
+        int reaped = IoGetEvents(Context, 1, Slots, Events.data());
+        if (reaped < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error(std::string("io_getevents() error: ") + strerror(errno));
+        }
+        auto completionTime = Nhrc::now();
+        for (int i = 0; i < reaped; i++) {
+            ui32 slot = Events[i].data;
+            if (Events[i].res < 0)
+                throw std::runtime_error(std::string("Linux AIO request error: ") + strerror(-Events[i].res));
+            bytesProcessed += Events[i].res;
+            if (OpLatencies)
+                RecordOp(SlotStarts[slot], completionTime, Requests[SlotRequests[slot]].Offset, Requests[SlotRequests[slot]].IsRead);
+            FreeSlots.push_back(slot);
+            inFlight--;
+            completed++;
+        }
+    }
+    auto end = Nhrc::now();
+    return {bytesProcessed, BatchLatency(start, end)};
+}
+#endif
+
 #endif
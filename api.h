@@ -5,11 +5,62 @@
 
 
 #include "globals.h"
+#include "histogram.h"
+#include "samples.h"
 
 #include <sys/types.h>
+#include <sys/uio.h> // struct iovec
 #include <vector>
 #include <chrono>
 #include <utility> // std::pair
+#include <memory> // std::unique_ptr
+
+#if defined (__linux__)
+#include <linux/io_uring.h> // struct io_uring_sqe, struct io_uring_cqe
+#include <linux/aio_abi.h> // aio_context_t, struct iocb, struct io_event
+#endif
+
+
+// ~ Class storing engine-specific parameters of a benchmark run
+// Engines ignore the parameters they do not support.
+struct TEngineParams {
+    // ~ Maximum number of requests in flight
+    // Asynchronous engines keep up to QueueDepth operations of a batch of buffers in flight.
+    ui32 QueueDepth = 1;
+    // ~ Flag showing that the file is opened with O_DIRECT
+    bool DirectIO = false;
+    // ~ Flag to poll the submission queue with a kernel thread
+    bool SqPoll = false;
+    // ~ Flag to poll for completions instead of waiting for interrupts
+    bool IoPoll = false;
+    // ~ Flag to register the buffers region up front
+    bool FixedBuffers = false;
+    // ~ Flag to register the file descriptor up front
+    bool FixedFiles = false;
+    // ~ Flag to populate the file mapping up front (MAP_POPULATE)
+    bool MapPopulate = false;
+    // ~ Access advice for the file mapping (see EMapAdvice)
+    ui32 MapAdvice = 0;
+    // ~ Flag to back the file mapping with transparent huge pages (the file must be on tmpfs)
+    bool MapHugePages = false;
+    // ~ Flag to flush every write to the file mapping with msync()
+    bool MapSync = false;
+    // ~ Per-operation flags of the preadv2 engine
+    // RWF_HIPRI for all the operations, RWF_NOWAIT for reads, RWF_DSYNC and RWF_APPEND for writes.
+    bool HighPriority = false;
+    bool NoWait = false;
+    bool DSync = false;
+    bool Append = false;
+};
+
+
+// ~ Access advices for the file mapping selectable through the "MADV" factor
+enum class EMapAdvice : ui32 {
+    Normal = 0,
+    Sequential = 1,
+    Random = 2,
+    WillNeed = 3,
+};
 
 
 // ~ API interface
@@ -28,6 +79,42 @@ public:
 
     virtual std::pair<ssize_t, ui64> Write(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets);
 
+    // ~ Mixed batch operations with time measurement
+    // i-th operation is a read if isRead[i] is set and a write otherwise.
+    // Homogeneous batches of equally sized operations are passed to Read() and Write().
+    // ~ Positional
+    virtual std::pair<ssize_t, ui64> ReadWrite(int fd, const std::vector<void*>& bufs, const std::vector<size_t>& counts, const std::vector<off_t>& offsets, const std::vector<char>& isRead);
+
+    // ~ Positional and vectored
+    virtual std::pair<ssize_t, ui64> ReadWrite(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets, const std::vector<char>& isRead);
+
+    // ~ Sets the histogram receiving latencies of single operations
+    // Per-operation measurement is disabled when nullptr is passed.
+    void SetOpLatencies(THistogram* opLatencies);
+
+    // ~ Sets the stream receiving raw samples of the operations measured
+    // Samples are only taken while the histogram is set. Disabled when nullptr is passed.
+    void SetSamples(TSampleStream* samples);
+
+    // ~ Sets the intended start times of the operations of the next batches
+    // The latency of the i-th operation of a batch is measured from intendedStarts[i] if it is
+    // earlier than the actual start, so that queueing behind late operations is not omitted.
+    // Disabled when nullptr is passed.
+    void SetIntendedStarts(const std::vector<TTimePoint>* intendedStarts);
+
+    // ~ Prepares the engine for a benchmark run on the file
+    // All the buffers passed to operations until Release() lie in the buffers region.
+    virtual void Setup(int fd, const struct iovec& buffers, const TEngineParams& params) {}
+
+    // ~ Releases the resources acquired in Setup()
+    virtual void Release() {}
+
+    // ~ Returns the number of operations which would have blocked (EAGAIN under RWF_NOWAIT)
+    ui64 GetWouldBlock() const;
+
+    // ~ Returns the total duration of the timed batches (in nanoseconds, not truncated like the latencies)
+    ui64 GetBusyTime() const;
+
 protected:
     // ~ Base operations
     virtual ssize_t pread(int fd, void* buf, size_t count, off_t offset) = 0;
@@ -38,6 +125,211 @@ protected:
 
     virtual ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) = 0;
 
+    // ~ Returns the time the latency of the op-th operation of a batch is measured from
+    inline TTimePoint OpStart(ui32 op, const TTimePoint& actualStart) const {
+        if (IntendedStarts && op < IntendedStarts->size() && (*IntendedStarts)[op] < actualStart)
+            return (*IntendedStarts)[op];
+        return actualStart;
+    }
+
+    // ~ Records a measured operation in the histogram and the raw samples
+    inline void RecordOp(const TTimePoint& start, const TTimePoint& end, off_t offset, bool isRead) {
+        OpLatencies->Add(Duration(start, end));
+        if (Samples)
+            Samples->Add(end, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), offset, isRead);
+    }
+
+    // ~ Returns the bytes transferred by a base operation, throws if it failed
+    // The error path is out of line, so that the loops only pay for the comparison.
+    static inline ssize_t Completed(ssize_t result) {
+        if (result < 0)
+            ThrowOpError();
+        return result;
+    }
+
+    [[noreturn]] static void ThrowOpError();
+
+    // ~ Returns the latency of a batch (in microseconds) and adds its duration to the busy time
+    inline ui64 BatchLatency(const TTimePoint& start, const TTimePoint& end) {
+        BusyTime += (end - start).count();
+        return Duration(start, end);
+    }
+
+protected:
+    THistogram* OpLatencies = nullptr;
+    TSampleStream* Samples = nullptr;
+    const std::vector<TTimePoint>* IntendedStarts = nullptr;
+    ui64 WouldBlock = 0;
+    ui64 BusyTime = 0;
+};
+
+
+// ~ Base class of synchronous API implementations with batch loops specialized at compile time
+// TEngine derives from TSyncAPI<TEngine> and provides the base operations, which are called
+// directly instead of through the vtable. A batch loop is instantiated for each direction mix,
+// measurement mode and timer source, and a table selects the instantiation before the timer starts,
+// so the only per-operation branch left in the timed path is the direction of a mixed batch.
+template <typename TEngine>
+class TSyncAPI : public IAPI {
+public:
+    virtual std::pair<ssize_t, ui64> Read(int fd, const std::vector<void*>& bufs, size_t count, const std::vector<off_t>& offsets) override {
+        return (this->*Batches[Reads][OpLatencies != nullptr][Timer()])(fd, bufs, &count, 0, offsets, nullptr);
+    }
+
+    virtual std::pair<ssize_t, ui64> Write(int fd, const std::vector<void*>& bufs, size_t count, const std::vector<off_t>& offsets) override {
+        return (this->*Batches[Writes][OpLatencies != nullptr][Timer()])(fd, bufs, &count, 0, offsets, nullptr);
+    }
+
+    virtual std::pair<ssize_t, ui64> Read(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets) override {
+        return (this->*VectoredBatches[Reads][OpLatencies != nullptr][Timer()])(fd, iovs, iovcnt, offsets, nullptr);
+    }
+
+    virtual std::pair<ssize_t, ui64> Write(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets) override {
+        return (this->*VectoredBatches[Writes][OpLatencies != nullptr][Timer()])(fd, iovs, iovcnt, offsets, nullptr);
+    }
+
+    virtual std::pair<ssize_t, ui64> ReadWrite(int fd, const std::vector<void*>& bufs, const std::vector<size_t>& counts, const std::vector<off_t>& offsets, const std::vector<char>& isRead) override {
+        return (this->*Batches[Mix(isRead)][OpLatencies != nullptr][Timer()])(fd, bufs, counts.data(), 1, offsets, &isRead);
+    }
+
+    virtual std::pair<ssize_t, ui64> ReadWrite(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets, const std::vector<char>& isRead) override {
+        return (this->*VectoredBatches[Mix(isRead)][OpLatencies != nullptr][Timer()])(fd, iovs, iovcnt, offsets, &isRead);
+    }
+
+private:
+    // ~ Directions of the operations of a batch
+    enum EMix : ui32 {
+        Reads = 0,
+        Writes = 1,
+        Mixed = 2,
+    };
+
+    static EMix Mix(const std::vector<char>& isRead) {
+        ui32 reads = 0;
+        for (char read : isRead)
+            reads += (read != 0);
+        return (reads == isRead.size() ? Reads : (reads == 0 ? Writes : Mixed));
+    }
+
+    static ui32 Timer() {
+        return static_cast<ui32>(Nhrc::GetSource());
+    }
+
+    // ~ Makes room for the completion times of a measured batch, allocates only when the batch grows
+    inline void PrepareOpEnds(size_t ops) {
+        if (OpEnds.size() < ops)
+            OpEnds.resize(ops);
+    }
+
+    // ~ Records the operations of a measured batch once its timer has stopped
+    // The operations run back to back, so each one starts when the previous one completes.
+    void RecordOps(const TTimePoint& start, size_t ops, const std::vector<off_t>& offsets,
+                   const std::vector<char>* isRead, bool reads) {
+        TTimePoint opStart = start;
+        for (ui32 i = 0; i < ops; i++) {
+            RecordOp(OpStart(i, opStart), OpEnds[i], offsets[i], reads || (isRead && (*isRead)[i]));
+            opStart = OpEnds[i];
+        }
+    }
+
+    // ~ Batch loop of an instantiation
+    // A measured loop reads the timer once per operation and records the operations after the batch,
+    // so neither a second timer read nor the histogram update falls into the latencies.
+    // The size of the i-th operation is counts[i * countsStep], i.e. a single size is passed with step 0.
+    template <ui32 TMix, bool TMeasured, ETimer TTimer>
+    std::pair<ssize_t, ui64> Batch(int fd, const std::vector<void*>& bufs, const size_t* counts, size_t countsStep,
+                                   const std::vector<off_t>& offsets, const std::vector<char>* isRead) {
+        TEngine* engine = static_cast<TEngine*>(this);
+        if constexpr (TMeasured)
+            PrepareOpEnds(bufs.size());
+        auto start = Nhrc::Now<TTimer>();
+        ssize_t bytesProcessed = 0;
+        for (ui32 i = 0; i < bufs.size(); i++) {
+            if (TMix == Reads || (TMix == Mixed && (*isRead)[i]))
+                bytesProcessed += Completed(engine->TEngine::pread(fd, bufs[i], counts[i * countsStep], offsets[i]));
+            else
+                bytesProcessed += Completed(engine->TEngine::pwrite(fd, bufs[i], counts[i * countsStep], offsets[i]));
+            if constexpr (TMeasured)
+                OpEnds[i] = Nhrc::Now<TTimer>();
+        }
+        auto end = (TMeasured && !bufs.empty() ? OpEnds[bufs.size() - 1] : Nhrc::Now<TTimer>());
+        if constexpr (TMeasured)
+            RecordOps(start, bufs.size(), offsets, isRead, TMix == Reads);
+        return {bytesProcessed, BatchLatency(start, end)};
+    }
+
+    template <ui32 TMix, bool TMeasured, ETimer TTimer>
+    std::pair<ssize_t, ui64> VectoredBatch(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt,
+                                           const std::vector<off_t>& offsets, const std::vector<char>* isRead) {
+        TEngine* engine = static_cast<TEngine*>(this);
+        if constexpr (TMeasured)
+            PrepareOpEnds(iovs.size());
+        auto start = Nhrc::Now<TTimer>();
+        ssize_t bytesProcessed = 0;
+        for (ui32 i = 0; i < iovs.size(); i++) {
+            if (TMix == Reads || (TMix == Mixed && (*isRead)[i]))
+                bytesProcessed += Completed(engine->TEngine::preadv(fd, iovs[i], iovcnt, offsets[i]));
+            else
+                bytesProcessed += Completed(engine->TEngine::pwritev(fd, iovs[i], iovcnt, offsets[i]));
+            if constexpr (TMeasured)
+                OpEnds[i] = Nhrc::Now<TTimer>();
+        }
+        auto end = (TMeasured && !iovs.empty() ? OpEnds[iovs.size() - 1] : Nhrc::Now<TTimer>());
+        if constexpr (TMeasured)
+            RecordOps(start, iovs.size(), offsets, isRead, TMix == Reads);
+        return {bytesProcessed, BatchLatency(start, end)};
+    }
+
+    using TBatch = std::pair<ssize_t, ui64> (TSyncAPI::*)(int, const std::vector<void*>&, const size_t*, size_t,
+                                                          const std::vector<off_t>&, const std::vector<char>*);
+    using TVectoredBatch = std::pair<ssize_t, ui64> (TSyncAPI::*)(int, const std::vector<const struct iovec*>&, int,
+                                                                  const std::vector<off_t>&, const std::vector<char>*);
+
+    // ~ Dispatch tables indexed by the direction mix, the measurement flag and the timer source
+    static constexpr TBatch Batches[3][2][3] = {
+        {{&TSyncAPI::Batch<Reads, false, ETimer::Default>,
+          &TSyncAPI::Batch<Reads, false, ETimer::MonotonicRaw>,
+          &TSyncAPI::Batch<Reads, false, ETimer::Tsc>},
+         {&TSyncAPI::Batch<Reads, true, ETimer::Default>,
+          &TSyncAPI::Batch<Reads, true, ETimer::MonotonicRaw>,
+          &TSyncAPI::Batch<Reads, true, ETimer::Tsc>}},
+        {{&TSyncAPI::Batch<Writes, false, ETimer::Default>,
+          &TSyncAPI::Batch<Writes, false, ETimer::MonotonicRaw>,
+          &TSyncAPI::Batch<Writes, false, ETimer::Tsc>},
+         {&TSyncAPI::Batch<Writes, true, ETimer::Default>,
+          &TSyncAPI::Batch<Writes, true, ETimer::MonotonicRaw>,
+          &TSyncAPI::Batch<Writes, true, ETimer::Tsc>}},
+        {{&TSyncAPI::Batch<Mixed, false, ETimer::Default>,
+          &TSyncAPI::Batch<Mixed, false, ETimer::MonotonicRaw>,
+          &TSyncAPI::Batch<Mixed, false, ETimer::Tsc>},
+         {&TSyncAPI::Batch<Mixed, true, ETimer::Default>,
+          &TSyncAPI::Batch<Mixed, true, ETimer::MonotonicRaw>,
+          &TSyncAPI::Batch<Mixed, true, ETimer::Tsc>}},
+    };
+    static constexpr TVectoredBatch VectoredBatches[3][2][3] = {
+        {{&TSyncAPI::VectoredBatch<Reads, false, ETimer::Default>,
+          &TSyncAPI::VectoredBatch<Reads, false, ETimer::MonotonicRaw>,
+          &TSyncAPI::VectoredBatch<Reads, false, ETimer::Tsc>},
+         {&TSyncAPI::VectoredBatch<Reads, true, ETimer::Default>,
+          &TSyncAPI::VectoredBatch<Reads, true, ETimer::MonotonicRaw>,
+          &TSyncAPI::VectoredBatch<Reads, true, ETimer::Tsc>}},
+        {{&TSyncAPI::VectoredBatch<Writes, false, ETimer::Default>,
+          &TSyncAPI::VectoredBatch<Writes, false, ETimer::MonotonicRaw>,
+          &TSyncAPI::VectoredBatch<Writes, false, ETimer::Tsc>},
+         {&TSyncAPI::VectoredBatch<Writes, true, ETimer::Default>,
+          &TSyncAPI::VectoredBatch<Writes, true, ETimer::MonotonicRaw>,
+          &TSyncAPI::VectoredBatch<Writes, true, ETimer::Tsc>}},
+        {{&TSyncAPI::VectoredBatch<Mixed, false, ETimer::Default>,
+          &TSyncAPI::VectoredBatch<Mixed, false, ETimer::MonotonicRaw>,
+          &TSyncAPI::VectoredBatch<Mixed, false, ETimer::Tsc>},
+         {&TSyncAPI::VectoredBatch<Mixed, true, ETimer::Default>,
+          &TSyncAPI::VectoredBatch<Mixed, true, ETimer::MonotonicRaw>,
+          &TSyncAPI::VectoredBatch<Mixed, true, ETimer::Tsc>}},
+    };
+
+private:
+    // ~ Completion times of the operations of the current measured batch
+    std::vector<TTimePoint> OpEnds;
 };
 
 
@@ -61,28 +353,63 @@ public:
 
     IAPI* Construct() override {
         APIs.clear();
-        APIs.emplace_back();
-        return &APIs.back();
+        APIs.emplace_back(new TAPI());
+        return APIs.back().get();
     }
 
     std::vector<IAPI*> Construct(ui32 amount) override {
         APIs.clear();
-        APIs.resize(amount);
         std::vector<IAPI*> result(amount);
         for (ui32 i = 0; i < amount; i++) {
-            result[i] = &APIs[i];
+            APIs.emplace_back(new TAPI());
+            result[i] = APIs.back().get();
         }
         return result;
     }
 
 private:
-    std::vector<TAPI> APIs;
+    // APIs are stored by pointer as they may own kernel resources and be non-copyable.
+    std::vector<std::unique_ptr<TAPI>> APIs;
+};
+
+
+// ~ I/O engines selectable through the "ENGINE" factor
+enum class EEngine : ui64 {
+    Posix = 0,
+    IoUring = 1,
+    LinuxAio = 2,
+    Mmap = 3,
+    Null = 4,
+    Preadv2 = 5,
 };
 
+// ~ Function constructing a factory of APIs implemented by the given engine
+std::unique_ptr<IAPIFactory> CreateAPIFactory(EEngine engine);
+
 
 // ~ API interface POSIX implementation
-class TPosixAPI : public IAPI {
+class TPosixAPI : public TSyncAPI<TPosixAPI> {
+public:
+    virtual ssize_t pread(int fd, void* buf, size_t count, off_t offset) override;
+
+    virtual ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) override;
+
+    virtual ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) override;
+
+    virtual ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) override;
+
+};
+
+
+#if defined (__linux__)
+// ~ API interface implementation with preadv2() and pwritev2()
+// The RWF_* flags of TEngineParams are passed with every operation. A read which would block
+// under RWF_NOWAIT is counted and reissued without the flag, as a reader falling back from
+// its cache-hit fast path would do.
+class TPreadv2API : public TSyncAPI<TPreadv2API> {
 public:
+    virtual void Setup(int fd, const struct iovec& buffers, const TEngineParams& params) override;
+
     virtual ssize_t pread(int fd, void* buf, size_t count, off_t offset) override;
 
     virtual ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) override;
@@ -91,7 +418,237 @@ public:
 
     virtual ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) override;
 
+private:
+    int ReadFlags = 0;
+    int WriteFlags = 0;
 };
+#endif
+
+
+// ~ API interface implementation performing no I/O
+// Operations complete at once transferring the whole count, so that a benchmark against it
+// measures the cost of the harness itself (timer reads, dispatch, bookkeeping).
+// The base operations are inline, so that the specialized batch loops are all that is left.
+class TNullAPI : public TSyncAPI<TNullAPI> {
+public:
+    virtual ssize_t pread(int fd, void* buf, size_t count, off_t offset) override { return count; }
+
+    virtual ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) override { return count; }
+
+    virtual ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) override {
+        ssize_t result = 0;
+        for (int i = 0; i < iovcnt; i++)
+            result += iov[i].iov_len;
+        return result;
+    }
+
+    virtual ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) override {
+        return preadv(fd, iov, iovcnt, offset);
+    }
+
+};
+
+
+// ~ API interface memory-mapped implementation
+// Setup() maps the whole file, operations are memcpy() to and from the mapping.
+// Until then (e.g. while the file is being filled) plain syscalls are used.
+class TMmapAPI : public TSyncAPI<TMmapAPI> {
+    friend class TSyncAPI<TMmapAPI>;
+
+public:
+    TMmapAPI() = default;
+
+    TMmapAPI(const TMmapAPI&) = delete;
+
+    TMmapAPI& operator=(const TMmapAPI&) = delete;
+
+    ~TMmapAPI();
+
+    virtual void Setup(int fd, const struct iovec& buffers, const TEngineParams& params) override;
+
+    virtual void Release() override;
+
+protected:
+    virtual ssize_t pread(int fd, void* buf, size_t count, off_t offset) override;
+
+    virtual ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) override;
+
+    virtual ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) override;
+
+    virtual ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) override;
+
+private:
+    // ~ Clamps the operation to the mapping and returns the amount of bytes to be copied
+    size_t Available(size_t count, off_t offset) const;
+
+    // ~ Flushes the written range if MapSync is set
+    void Sync(off_t offset, size_t count) const;
+
+private:
+    char* Mapping = nullptr;
+    size_t MappingSize = 0;
+    bool MapSync = false;
+};
+
+
+// ~ Base class of asynchronous API implementations
+// Unlike TPosixAPI, every buffer (or iovec) of a batch is an independent request.
+// Up to QD requests are kept in flight: new requests are submitted in groups as soon as
+// the completions are reaped. QD equals iovcnt for vectored operations and 1 otherwise.
+class TAsyncAPI : public IAPI {
+public:
+    virtual std::pair<ssize_t, ui64> Read(int fd, const std::vector<void*>& bufs, size_t count, const std::vector<off_t>& offsets) override;
+
+    virtual std::pair<ssize_t, ui64> Write(int fd, const std::vector<void*>& bufs, size_t count, const std::vector<off_t>& offsets) override;
+
+    virtual std::pair<ssize_t, ui64> Read(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets) override;
+
+    virtual std::pair<ssize_t, ui64> Write(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets) override;
+
+    virtual std::pair<ssize_t, ui64> ReadWrite(int fd, const std::vector<void*>& bufs, const std::vector<size_t>& counts, const std::vector<off_t>& offsets, const std::vector<char>& isRead) override;
+
+    virtual std::pair<ssize_t, ui64> ReadWrite(int fd, const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets, const std::vector<char>& isRead) override;
+
+protected:
+    // ~ Synchronous base operations (each one is a single batch)
+    virtual ssize_t pread(int fd, void* buf, size_t count, off_t offset) override;
+
+    virtual ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) override;
+
+    virtual ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) override;
+
+    virtual ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) override;
+
+protected:
+    // ~ Single request of a batch
+    struct TRequest {
+        void* Buf;
+        size_t Count;
+        off_t Offset;
+        bool IsRead;
+        // ~ Index of the batch operation the request belongs to
+        ui32 Op;
+    };
+
+    // ~ Performs Requests keeping up to depth of them in flight
+    // Returns the amount of bytes processed and the time taken by the whole batch.
+    virtual std::pair<ssize_t, ui64> Execute(int fd, ui32 depth) = 0;
+
+    // ~ Fills Requests with the buffers of vectored operations
+    // Direction of i-th operation is taken from isRead[i] or is the same for all if isRead is nullptr.
+    void SplitIovs(const std::vector<const struct iovec*>& iovs, int iovcnt, const std::vector<off_t>& offsets,
+                   const std::vector<char>* isRead, bool allRead);
+
+protected:
+    // ~ Requests of the current batch
+    // Vectors are kept between batches to avoid allocations.
+    std::vector<TRequest> Requests;
+    // ~ Submission time of the request occupying each slot
+    std::vector<TTimePoint> SlotStarts;
+    // ~ Index of the request occupying each slot
+    std::vector<ui32> SlotRequests;
+    std::vector<ui32> FreeSlots;
+    // ~ Depth of batches of buffers (set from TEngineParams::QueueDepth by Setup())
+    ui32 BufferDepth = 1;
+};
+
+
+#if defined (__linux__)
+// ~ API interface io_uring implementation
+// Setup() enables SQPOLL/IOPOLL and registers the buffers region and the file.
+class TIoUringAPI : public TAsyncAPI {
+public:
+    TIoUringAPI() = default;
+
+    TIoUringAPI(const TIoUringAPI&) = delete;
+
+    TIoUringAPI& operator=(const TIoUringAPI&) = delete;
+
+    ~TIoUringAPI();
+
+    // ~ Creates the ring with the polling modes and registrations requested
+    virtual void Setup(int fd, const struct iovec& buffers, const TEngineParams& params) override;
+
+    virtual void Release() override;
+
+protected:
+    virtual std::pair<ssize_t, ui64> Execute(int fd, ui32 depth) override;
+
+private:
+    // ~ Creates the ring if there is none or if it has less than depth entries
+    void SetupRing(ui32 depth);
+
+    void DestroyRing();
+
+    // ~ Checks that the request buffer lies in the registered buffers region
+    bool IsRegistered(const TRequest& request) const;
+
+private:
+    int RingFd = -1;
+    ui32 Entries = 0;
+
+    // ~ Parameters and resources passed in Setup()
+    TEngineParams Params;
+    int RegisteredFd = -1;
+    struct iovec RegisteredBuffers = {nullptr, 0};
+    // ~ Pointer to the submission queue flags (checked for IORING_SQ_NEED_WAKEUP)
+    unsigned* SqFlags = nullptr;
+
+    // ~ Mapped ring memory
+    void* SqRing = nullptr;
+    size_t SqRingSize = 0;
+    void* CqRing = nullptr;
+    size_t CqRingSize = 0;
+    struct io_uring_sqe* Sqes = nullptr;
+    size_t SqesSize = 0;
+
+    // ~ Pointers to the ring fields shared with the kernel
+    unsigned* SqTail = nullptr;
+    unsigned* SqMask = nullptr;
+    unsigned* SqArray = nullptr;
+    unsigned* CqHead = nullptr;
+    unsigned* CqTail = nullptr;
+    unsigned* CqMask = nullptr;
+    struct io_uring_cqe* Cqes = nullptr;
+};
+
+
+// ~ API interface Linux native AIO implementation
+// Kernel AIO is only asynchronous for files opened with O_DIRECT,
+// so Setup() rejects runs with DirectIO = 0.
+class TLinuxAioAPI : public TAsyncAPI {
+public:
+    TLinuxAioAPI() = default;
+
+    TLinuxAioAPI(const TLinuxAioAPI&) = delete;
+
+    TLinuxAioAPI& operator=(const TLinuxAioAPI&) = delete;
+
+    ~TLinuxAioAPI();
+
+    virtual void Setup(int fd, const struct iovec& buffers, const TEngineParams& params) override;
+
+    virtual void Release() override;
+
+protected:
+    virtual std::pair<ssize_t, ui64> Execute(int fd, ui32 depth) override;
+
+private:
+    // ~ Creates the context if there is none or if it has less than depth slots
+    void SetupContext(ui32 depth);
+
+    void DestroyContext();
+
+private:
+    aio_context_t Context = 0;
+    ui32 Slots = 0;
+
+    // ~ Control blocks of the slots and pointers to the ones being submitted
+    std::vector<struct iocb> Iocbs;
+    std::vector<struct iocb*> Pending;
+    std::vector<struct io_event> Events;
+};
+#endif
 
 
 #endif
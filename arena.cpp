@@ -0,0 +1,110 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __ARENA__CPP__
+#define __ARENA__CPP__
+
+
+#include "arena.h"
+
+#include <sys/mman.h> // mmap(), munmap()
+#include <sys/stat.h> // fstat(), statx()
+#include <sys/ioctl.h> // ioctl()
+#include <fcntl.h> // AT_EMPTY_PATH
+#include <unistd.h> // sysconf()
+#include <stdexcept> // runtime_error
+#include <string> // std::to_string()
+#include <algorithm> // std::max()
+
+#if defined (__linux__)
+#include <linux/fs.h> // BLKSSZGET
+#endif
+
+
+// Size of the huge pages used for the slab (x86-64 and aarch64 default)
+constexpr ui64 HugePageSize = 2 * 1024 * 1024;
+
+
+TDirectIOAlignment GetDirectIOAlignment(int fd) {
+    TDirectIOAlignment alignment;
+    alignment.Memory = alignment.Offset = sysconf(_SC_PAGESIZE);
+
+    #if defined (__linux__) && defined (STATX_DIOALIGN)
+    struct statx stx;
+    if (statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0
+        && (stx.stx_mask & STATX_DIOALIGN) && stx.stx_dio_offset_align != 0) {
+        alignment.Memory = stx.stx_dio_mem_align;
+        alignment.Offset = stx.stx_dio_offset_align;
+        return alignment;
+    }
+    #endif
+
+    #if defined (__linux__)
+    struct stat st;
+    int sectorSize;
+    if (fstat(fd, &st) == 0 && S_ISBLK(st.st_mode) && ioctl(fd, BLKSSZGET, &sectorSize) == 0)
+        alignment.Memory = alignment.Offset = sectorSize;
+    #endif
+
+    return alignment;
+}
+
+
+TBufferArena::~TBufferArena() {
+    Free();
+}
+
+
+void TBufferArena::Reserve(ui64 size, bool hugePages) {
+    Used = 0;
+    if (Slab && Size >= size && HugePages == hugePages)
+        return;
+    Free();
+
+    ui64 pageSize = (hugePages ? HugePageSize : sysconf(_SC_PAGESIZE));
+    size = std::max<ui64>((size + pageSize - 1) / pageSize * pageSize, pageSize);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE;
+    #if defined (__linux__)
+    if (hugePages)
+        flags |= MAP_HUGETLB;
+    #endif
+
+    void* slab = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (slab == MAP_FAILED)
+        throw std::runtime_error("TBufferArena::Reserve() error: cannot map " + std::to_string(size) +
+                                 " bytes" + (hugePages ? " of huge pages" : ""));
+    Slab = slab;
+    Size = size;
+    HugePages = hugePages;
+}
+
+
+void* TBufferArena::Allocate(ui64 size, ui64 alignment) {
+    ui64 start = (Used + alignment - 1) & ~(alignment - 1);
+    if (!Slab || start + size > Size)
+        throw std::runtime_error("TBufferArena::Allocate() error: arena of " + std::to_string(Size) +
+                                 " bytes is exhausted");
+    Used = start + size;
+    return static_cast<char*>(Slab) + start;
+}
+
+
+void TBufferArena::Reset() {
+    Used = 0;
+}
+
+
+struct iovec TBufferArena::Region() const {
+    return {Slab, Size};
+}
+
+
+void TBufferArena::Free() {
+    if (Slab)
+        munmap(Slab, Size);
+    Slab = nullptr;
+    Size = 0;
+    Used = 0;
+}
+
+
+#endif
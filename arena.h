@@ -0,0 +1,63 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __ARENA__H__
+#define __ARENA__H__
+
+
+#include "globals.h"
+
+#include <sys/uio.h> // struct iovec
+
+
+// ~ Class storing direct I/O alignment requirements of a file
+struct TDirectIOAlignment {
+    // ~ Required alignment of buffer addresses (in bytes)
+    ui64 Memory = 4096;
+    // ~ Required alignment of file offsets and operation sizes (in bytes)
+    ui64 Offset = 4096;
+};
+
+// ~ Function querying the direct I/O alignment requirements of an open file
+// Uses statx(STATX_DIOALIGN) if supported, the logical block size for block devices,
+// and falls back to the page size otherwise.
+TDirectIOAlignment GetDirectIOAlignment(int fd);
+
+
+// ~ Arena allocator of I/O buffers
+// All the buffers are carved out of a single page-aligned (or hugepage-aligned) slab,
+// which is kept between Reset() calls and only grows when a bigger one is reserved.
+class TBufferArena {
+public:
+    TBufferArena() = default;
+
+    TBufferArena(const TBufferArena&) = delete;
+
+    TBufferArena& operator=(const TBufferArena&) = delete;
+
+    ~TBufferArena();
+
+    // ~ Makes the slab hold at least size bytes
+    // The current slab is kept if it is big enough and of the same page kind.
+    void Reserve(ui64 size, bool hugePages);
+
+    // ~ Carves a buffer aligned to alignment (a power of two) out of the slab
+    void* Allocate(ui64 size, ui64 alignment);
+
+    // ~ Returns all the buffers to the arena keeping the slab
+    void Reset();
+
+    // ~ Returns the whole slab as a single region
+    struct iovec Region() const;
+
+private:
+    void Free();
+
+private:
+    void* Slab = nullptr;
+    ui64 Size = 0;
+    ui64 Used = 0;
+    bool HugePages = false;
+};
+
+
+#endif
@@ -17,6 +17,14 @@
 #include <tuple> // std::tie()
 #include <array> // std::array
 #include <cstdio> // popen()
+#include <thread> // std::thread
+#include <exception> // std::exception_ptr
+#include <algorithm> // std::min(), std::max()
+#include <random> // std::random_device
+#include <string> // std::to_string()
+#include <sys/resource.h> // getrusage()
+#include <limits> // std::numeric_limits
+#include <type_traits> // std::true_type, std::false_type
 
 #include <iostream>
 using namespace std;
@@ -40,6 +48,102 @@ std::pair<ui64, ui64> Statistics(const std::vector<ui64>& sample) {
 }
 
 
+std::pair<ld, ld> BatchMeansInterval(const std::vector<ui64>& values, const std::vector<ui64>& weights) {
+    // ~ 97.5% quantiles of Student's t distribution with 1 to BatchMeansGroups - 1 degrees of freedom
+    static constexpr std::array<ld, BatchMeansGroups - 1> quantiles = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093};
+
+    ui64 size = values.size();
+    if (size < 2)
+        return {(size == 0 ? 0 : (ld)values[0] / (weights.empty() ? 1 : std::max<ui64>(weights[0], 1))),
+                std::numeric_limits<ld>::infinity()};
+    ui32 groups = std::min<ui64>(size, BatchMeansGroups);
+    std::array<ld, BatchMeansGroups> means;
+    ld valuesSum = 0;
+    ld weightsSum = 0;
+    for (ui32 g = 0; g < groups; g++) {
+        ld groupValues = 0;
+        ld groupWeights = 0;
+        for (ui64 i = g * size / groups; i < (g + 1) * size / groups; i++) {
+            groupValues += values[i];
+            groupWeights += (weights.empty() ? 1 : weights[i]);
+        }
+        means[g] = groupValues / std::max<ld>(groupWeights, 1);
+        valuesSum += groupValues;
+        weightsSum += groupWeights;
+    }
+    ld mean = valuesSum / std::max<ld>(weightsSum, 1);
+
+    ld squaresSum = 0;
+    for (ui32 g = 0; g < groups; g++)
+        squaresSum += (means[g] - mean) * (means[g] - mean);
+    ld error = sqrtl(squaresSum / (groups - 1) / groups);
+    return {mean, quantiles[groups - 2] * error};
+}
+
+
+TBatchMeans::TBatchMeans() {
+    Values.reserve(2 * BatchMeansGroups);
+    Weights.reserve(2 * BatchMeansGroups);
+}
+
+void TBatchMeans::Add(ui64 value, ui64 weight) {
+    Value += value;
+    Weight += weight;
+    Count++;
+    if (++Filled < GroupSize)
+        return;
+    Values.push_back(Value);
+    Weights.push_back(Weight);
+    Value = Weight = Filled = 0;
+    if (Values.size() < 2 * BatchMeansGroups)
+        return;
+    for (ui32 i = 0; i < BatchMeansGroups; i++) {
+        Values[i] = Values[2 * i] + Values[2 * i + 1];
+        Weights[i] = Weights[2 * i] + Weights[2 * i + 1];
+    }
+    Values.resize(BatchMeansGroups);
+    Weights.resize(BatchMeansGroups);
+    GroupSize *= 2;
+}
+
+std::pair<ld, ld> TBatchMeans::Interval() const {
+    if (Values.empty())
+        return {(ld)Value / std::max<ui64>(Weight, 1), std::numeric_limits<ld>::infinity()};
+    return BatchMeansInterval(Values, Weights);
+}
+
+
+// ~ Converts the interval of the throughput in bytes per microsecond to bytes per second
+static std::pair<ld, ld> PerSecond(const std::pair<ld, ld>& interval) {
+    return {interval.first * 1_s, interval.second * 1_s};
+}
+
+
+std::pair<ui64, ui64> ThreadPageFaults() {
+    struct rusage usage;
+    #if defined (__linux__)
+    if (getrusage(RUSAGE_THREAD, &usage) == -1)
+        return {0, 0};
+    #else
+    if (getrusage(RUSAGE_SELF, &usage) == -1)
+        return {0, 0};
+    #endif
+    return {usage.ru_minflt, usage.ru_majflt};
+}
+
+
+// ~ Waits for the time point sleeping most of the time and spinning for the rest
+// Plain sleeping oversleeps by tens of microseconds, which would be taken for latency.
+static void WaitUntil(const TTimePoint& timePoint) {
+    auto spinStart = timePoint - std::chrono::microseconds(100);
+    if (Nhrc::now() < spinStart)
+        std::this_thread::sleep_until(spinStart);
+    while (Nhrc::now() < timePoint) {}
+}
+
+
 std::string ExecuteCommand(const char* command, ui32& exitStatus) {
     auto pipePtr = popen(command, "r");
     if (!pipePtr)
@@ -53,6 +157,35 @@ std::string ExecuteCommand(const char* command, ui32& exitStatus) {
 }
 
 
+// ~ Factors with the flags showing that their levels are categories
+// A factor added to TFactorLevels is declared here, in the order the factors are listed to the user.
+static const std::vector<std::pair<std::string, bool>> Factors = {
+    {"RS", false}, {"QD", false}, {"DIO", false}, {"ENGINE", true},
+    {"SQPOLL", false}, {"IOPOLL", false}, {"FIXBUF", false}, {"FIXFILE", false},
+    {"THREADS", false}, {"SHARED", false}, {"READ", false}, {"SEQ", false}, {"HUGEBUF", false},
+    {"MAPPOP", false}, {"MADV", true}, {"MAPHUGE", false}, {"MSYNC", false},
+    {"HIPRI", false}, {"NOWAIT", false}, {"DSYNC", false}, {"APPEND", false}, {"SYNC", true}, {"SYNCN", false},
+    {"WAL", true}, {"GROUP", false}, {"PREALLOC", false}, {"CACHE", true}, {"WARMPCT", false},
+    {"FADV", true}, {"RAHEAD", false}, {"BLKRA", false},
+    {"DIST", true}, {"THETA", false}, {"HOTOPS", false}, {"HOTSPACE", false}, {"PARETO", false},
+    {"TRACETIME", false}, {"RATE", false}, {"ARRIVAL", true}};
+
+const std::vector<std::string> FactorNames = []() {
+    std::vector<std::string> names;
+    for (const auto& [name, categorical] : Factors)
+        names.push_back(name);
+    return names;
+}();
+
+
+bool IsCategorical(const std::string& factor) {
+    for (const auto& [name, categorical] : Factors)
+        if (name == factor)
+            return categorical;
+    throw runtime_error("IsCategorical() error: factor " + factor + " not supported");
+}
+
+
 void TFactorLevels::SetLevel(const std::string& factor, ui64 level) {
     if (factor == "RS")
         RequestSize = level;
@@ -60,6 +193,78 @@ void TFactorLevels::SetLevel(const std::string& factor, ui64 level) {
         QueueDepth = level;
     else if (factor == "DIO")
         DirectIO = level;
+    else if (factor == "ENGINE")
+        Engine = level;
+    else if (factor == "SQPOLL")
+        SqPoll = level;
+    else if (factor == "IOPOLL")
+        IoPoll = level;
+    else if (factor == "FIXBUF")
+        FixedBuffers = level;
+    else if (factor == "FIXFILE")
+        FixedFiles = level;
+    else if (factor == "THREADS")
+        Threads = level;
+    else if (factor == "SHARED")
+        SharedFile = level;
+    else if (factor == "READ")
+        ReadPercent = level;
+    else if (factor == "SEQ")
+        ConsecutivePercent = level;
+    else if (factor == "HUGEBUF")
+        HugeBuffers = level;
+    else if (factor == "MAPPOP")
+        MapPopulate = level;
+    else if (factor == "MADV")
+        MapAdvice = level;
+    else if (factor == "MAPHUGE")
+        MapHugePages = level;
+    else if (factor == "MSYNC")
+        MapSync = level;
+    else if (factor == "HIPRI")
+        HighPriority = level;
+    else if (factor == "NOWAIT")
+        NoWait = level;
+    else if (factor == "DSYNC")
+        DSync = level;
+    else if (factor == "APPEND")
+        Append = level;
+    else if (factor == "SYNC")
+        Sync = level;
+    else if (factor == "SYNCN")
+        SyncEvery = level;
+    else if (factor == "WAL")
+        Wal = level;
+    else if (factor == "GROUP")
+        GroupSize = level;
+    else if (factor == "PREALLOC")
+        Preallocate = level;
+    else if (factor == "CACHE")
+        CacheState = level;
+    else if (factor == "WARMPCT")
+        WarmPercent = level;
+    else if (factor == "FADV")
+        FileAdvice = level;
+    else if (factor == "RAHEAD")
+        Readahead = level;
+    else if (factor == "BLKRA")
+        BlockReadahead = level;
+    else if (factor == "DIST")
+        Distribution = level;
+    else if (factor == "THETA")
+        ZipfTheta = level;
+    else if (factor == "HOTOPS")
+        HotOpsPercent = level;
+    else if (factor == "HOTSPACE")
+        HotSpacePercent = level;
+    else if (factor == "PARETO")
+        ParetoShape = level;
+    else if (factor == "TRACETIME")
+        TraceTiming = level;
+    else if (factor == "RATE")
+        Rate = level;
+    else if (factor == "ARRIVAL")
+        Arrival = level;
     else
         throw runtime_error("TFactorsLevels::SetLevel() error: "
                             "factor " + factor + " not supported");
@@ -73,155 +278,821 @@ ui64 TFactorLevels::GetLevel(const std::string& factor) const {
         return QueueDepth;
     else if (factor == "DIO")
         return DirectIO;
+    else if (factor == "ENGINE")
+        return Engine;
+    else if (factor == "SQPOLL")
+        return SqPoll;
+    else if (factor == "IOPOLL")
+        return IoPoll;
+    else if (factor == "FIXBUF")
+        return FixedBuffers;
+    else if (factor == "FIXFILE")
+        return FixedFiles;
+    else if (factor == "THREADS")
+        return Threads;
+    else if (factor == "SHARED")
+        return SharedFile;
+    else if (factor == "READ")
+        return ReadPercent;
+    else if (factor == "SEQ")
+        return ConsecutivePercent;
+    else if (factor == "HUGEBUF")
+        return HugeBuffers;
+    else if (factor == "MAPPOP")
+        return MapPopulate;
+    else if (factor == "MADV")
+        return MapAdvice;
+    else if (factor == "MAPHUGE")
+        return MapHugePages;
+    else if (factor == "MSYNC")
+        return MapSync;
+    else if (factor == "HIPRI")
+        return HighPriority;
+    else if (factor == "NOWAIT")
+        return NoWait;
+    else if (factor == "DSYNC")
+        return DSync;
+    else if (factor == "APPEND")
+        return Append;
+    else if (factor == "SYNC")
+        return Sync;
+    else if (factor == "SYNCN")
+        return SyncEvery;
+    else if (factor == "WAL")
+        return Wal;
+    else if (factor == "GROUP")
+        return GroupSize;
+    else if (factor == "PREALLOC")
+        return Preallocate;
+    else if (factor == "CACHE")
+        return CacheState;
+    else if (factor == "WARMPCT")
+        return WarmPercent;
+    else if (factor == "FADV")
+        return FileAdvice;
+    else if (factor == "RAHEAD")
+        return Readahead;
+    else if (factor == "BLKRA")
+        return BlockReadahead;
+    else if (factor == "DIST")
+        return Distribution;
+    else if (factor == "THETA")
+        return ZipfTheta;
+    else if (factor == "HOTOPS")
+        return HotOpsPercent;
+    else if (factor == "HOTSPACE")
+        return HotSpacePercent;
+    else if (factor == "PARETO")
+        return ParetoShape;
+    else if (factor == "TRACETIME")
+        return TraceTiming;
+    else if (factor == "RATE")
+        return Rate;
+    else if (factor == "ARRIVAL")
+        return Arrival;
     else
         throw runtime_error("TFactorsLevels::GetLevel() error: "
                             "Factor " + factor + " not supported");
 }
 
 
+TFactorLevels::TFactorLevels(const TPattern& pattern)
+    : ReadPercent(pattern.ReadPercent)
+    , ConsecutivePercent(pattern.ConsecutivePercent)
+    , Distribution(pattern.Distribution)
+    , ZipfTheta(pattern.ZipfTheta)
+    , HotOpsPercent(pattern.HotOpsPercent)
+    , HotSpacePercent(pattern.HotSpacePercent)
+    , ParetoShape(pattern.ParetoShape)
+    , TraceTiming(pattern.TraceTiming) {}
+
+
 TBenchmark::TBenchmark(TPattern pattern,
                        const TFactorLevels& factorLevels,
                        const TWarmupParams& warmup,
                        const TEnvironmentParams& environment,
                        ui64 testDuration,
                        ui32 batchSize,
-                       IAPIFactory* factory)
+                       IAPIFactory* factory,
+                       std::shared_ptr<TFixtureCache> fixtures,
+                       std::shared_ptr<TTimeSeriesWriter> timeSeries,
+                       std::shared_ptr<TSampleWriter> samples)
                        : Pattern(pattern)
                        , FactorLevels(factorLevels)
                        , Warmup(warmup)
                        , Environment(environment)
                        , TestDuration(testDuration)
                        , BatchSize(batchSize)
-                       , Factory(factory) {}
+                       , Factory(factory)
+                       , Fixtures(fixtures)
+                       , TimeSeries(timeSeries)
+                       , Samples(samples) {}
+
+
+TBenchmarkResult TBenchmark::Benchmark() {
+    ui32 fd = PrepareEnvironment();
+    // The device readahead is restored and the file closed whichever way the run finishes.
+    struct TRestore {
+        TBenchmark& Benchmark;
+        int Fd;
+        ~TRestore() {
+            if (Benchmark.SavedBlockReadahead != -1) {
+                try {
+                    SetBlockReadahead(Fd, Benchmark.SavedBlockReadahead);
+                } catch (const std::exception& e) {
+                    std::cerr << "BLKRA not restored: " << e.what() << "\n";
+                }
+                Benchmark.SavedBlockReadahead = -1;
+            }
+            close(Fd);
+        }
+    } restore{*this, static_cast<int>(fd)};
 
+    ui32 threads = std::max<ui64>(FactorLevels.Threads, 1);
+    std::vector<IAPI*> apis = Factory->Construct(threads);
+    while (Arenas.size() < threads)
+        Arenas.push_back(std::make_shared<TBufferArena>());
 
-std::vector<ui64> TBenchmark::Benchmark() {
+    // ~ Results are written by each worker into its own slot and merged after the run
+    TBenchmarkResult result;
+    result.Workers.resize(threads);
+    std::vector<std::exception_ptr> errors(threads);
+
+    // Split the file into disjoint regions unless it is shared by all the workers.
+    ui64 filesize = Environment.Filesize;
+    ui64 regionSize = (FactorLevels.SharedFile ? filesize : filesize / threads);
+    regionSize -= regionSize % Alignment.Offset;
+    ui64 seed = Environment.Seed;
+    if (seed == 0)
+        seed = (static_cast<ui64>(std::random_device()()) << 32) | std::random_device()();
+    std::cerr << "Seed: " << seed << "\n";
+
+    std::unique_ptr<TTraceReader> trace;
+    if (!Pattern.TracePath.empty())
+        trace.reset(new TTraceReader(Pattern.TracePath));
+
+    // The log of the append workload lies next to the test file.
+    std::unique_ptr<TGroupCommit> log;
+    if (static_cast<EWalMode>(FactorLevels.Wal) != EWalMode::Off)
+        log.reset(new TGroupCommit(Environment.Filepath + ".wal", static_cast<EWalMode>(FactorLevels.Wal),
+                                   filesize, FactorLevels.Preallocate, FactorLevels.DirectIO,
+                                   threads, FactorLevels.GroupSize));
+
+    // The cache state is set once all the workers are warm, so that the measurement starts from it
+    // rather than from the pages the warmup loaded. The resident fraction is checked once, right after.
+    TMeasurementBarrier barrier(threads, [&]() {
+        SetCacheState(Environment.Filepath, static_cast<ECacheState>(FactorLevels.CacheState), FactorLevels.WarmPercent);
+        result.Resident = ResidentFraction(Environment.Filepath);
+    });
+
+    std::atomic<ui32> converged(0);
+    std::vector<std::thread> workers;
+    for (ui32 i = 0; i < threads; i++) {
+        off_t regionStart = (FactorLevels.SharedFile ? 0 : i * regionSize);
+        workers.emplace_back([&, i, regionStart]() {
+            try {
+                if (log)
+                    RunWalWorker(apis[i], *Arenas[i], *log, i, barrier, result.Workers[i]);
+                else if (trace)
+                    RunTraceWorker(apis[i], *Arenas[i], fd, *trace, i, threads, barrier, result.Workers[i]);
+                else
+                    RunWorker(apis[i], *Arenas[i], fd, regionStart, regionSize, i, seed + i, converged, barrier,
+                              result.Workers[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+            barrier.Leave();
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    if (Environment.Precision > 0 && !trace && !log)
+        std::cerr << "Converged workers: " << converged.load() << "/" << threads << "\n";
+
+    for (const auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    ui64 minIterations = result.Workers[0].Iterations;
+    for (const auto& worker : result.Workers) {
+        result.OpLatencies.Merge(worker.OpLatencies);
+        result.MinorFaults += worker.MinorFaults;
+        result.MajorFaults += worker.MajorFaults;
+        result.WouldBlock += worker.WouldBlock;
+        result.FlushLatencies.Merge(worker.FlushLatencies);
+        result.ThroughputInterval.first += worker.ThroughputInterval.first;
+        result.ThroughputInterval.second += worker.ThroughputInterval.second * worker.ThroughputInterval.second;
+        minIterations = std::min<ui64>(minIterations, worker.Iterations);
+    }
+    result.ThroughputInterval.second = sqrtl(result.ThroughputInterval.second);
+    std::cerr << "Throughput: " << (ui64)result.ThroughputInterval.first << " +- "
+              << result.ThroughputInterval.second << " B/s\n";
+    if (MinIterations == 0)
+        MinIterations = minIterations;
+
+    return result;
+}
+
+
+void TBenchmark::RunWorker(IAPI* api, TBufferArena& arena, ui32 fd, off_t regionStart, ui64 regionSize,
+                           ui32 worker, ui64 seed, std::atomic<ui32>& converged, TMeasurementBarrier& barrier,
+                           TWorkerResult& result) const {
     // ~ Parameter aliases
     ui64 rs = FactorLevels.RequestSize;
     ui64 qd = FactorLevels.QueueDepth;
-    ui32 fd = PrepareEnvironment();
-    ui64 filesize = Environment.Filesize;
-    IAPI* api = Factory->Construct();
 
-    const ui64 bufSize = ceil((long double)rs / sizeof(ui32));
+    // ~ Cumulative distribution of operation sizes as (size, cumulative percentage) pairs
+    std::vector<std::pair<ui64, ui64>> sizes;
+    for (auto [size, percent] : Pattern.RequestSizes)
+        sizes.emplace_back(size, (sizes.empty() ? 0 : sizes.back().second) + percent);
+    if (sizes.empty())
+        sizes.emplace_back(rs, 100);
+    ui64 maxSize = 0;
+    ui64 minSize = sizes[0].first;
+    for (auto [size, percent] : sizes) {
+        maxSize = std::max(maxSize, size);
+        minSize = std::min(minSize, size);
+    }
+    if (maxSize * qd > regionSize)
+        throw std::runtime_error("TBenchmark::RunWorker() error: operation size exceeds the file region");
+
+    // ~ Buffers are page-aligned (or stricter if direct I/O requires)
+    const ui64 bufAlignment = std::max<ui64>(sysconf(_SC_PAGESIZE), Alignment.Memory);
+    const ui64 bufStride = (maxSize + bufAlignment - 1) / bufAlignment * bufAlignment;
+    arena.Reserve(BatchSize * qd * bufStride, FactorLevels.HugeBuffers);
     // ~ Buffers for storing data used in operations
-    std::vector<std::unique_ptr<ui32[]>> bufferPtrs(BatchSize); // Case of qd == 1
+    std::vector<ui32*> bufferPtrs(BatchSize); // Case of qd == 1
     std::vector<std::unique_ptr<struct iovec[]>> iovPtrs(BatchSize); // Case of qd > 1
-    // ~ Unique ptrs storing the actual data
-    std::vector<std::unique_ptr<ui32[]>> iovData(BatchSize * qd); 
+    // ~ Pointers to the actual data
+    std::vector<ui32*> iovData(BatchSize * qd);
 
-    // Allocate data for buffers.
+    // Carve buffers out of the arena.
     for (ui32 i = 0; i < BatchSize; i++) {
         if (qd == 1) {
-            bufferPtrs[i].reset(new ui32[bufSize]);
+            bufferPtrs[i] = static_cast<ui32*>(arena.Allocate(maxSize, bufAlignment));
         } else if (qd > 1) {
             iovPtrs[i].reset(new struct iovec[qd]);
             for (ui32 j = 0; j < qd; j++) {
-                iovData[i * qd + j] = std::unique_ptr<ui32[]>(new ui32[bufSize]);
-                iovPtrs[i][j].iov_base = iovData[i * qd + j].get();
+                iovData[i * qd + j] = static_cast<ui32*>(arena.Allocate(maxSize, bufAlignment));
+                iovPtrs[i][j].iov_base = iovData[i * qd + j];
                 iovPtrs[i][j].iov_len = rs;
             }
         }
     }
 
+    api->Setup(fd, arena.Region(), GetEngineParams());
+
     // ~ Vectors of buffers and iovs used as arguments in read and write operation calls
     std::vector<void *> bufs(BatchSize);
     std::vector<const struct iovec*> iovs(BatchSize);
     for (ui32 i = 0; i < BatchSize; i++) {
-        bufs[i] = bufferPtrs[i].get();
+        bufs[i] = bufferPtrs[i];
         iovs[i] = iovPtrs[i].get();
     }
 
     // ~ Batch latencies
-    std::vector<ui64> latencies;
-
-    // ~ File offsets for each operation in batch
-    std::vector<off_t> offsets(BatchSize, 0);
-    // Set offsets for the first batch.
-    if (Pattern.IsConsecutive) {
-        for (ui32 i = 1; i < BatchSize; i++)
-            offsets[i] = offsets[i - 1] + rs * qd;
-    }
-    else {
-        for (ui32 i = 0; i < BatchSize; i++)
-            offsets[i] = RandomUI32() % (filesize - rs * qd);
+    std::vector<ui64>& latencies = result.Latencies;
+
+    // ~ Operation sizes, directions and file offsets for each operation in batch
+    std::vector<size_t> counts(BatchSize, rs);
+    std::vector<char> isRead(BatchSize);
+    std::vector<off_t> offsets(BatchSize, regionStart);
+    // ~ Position of the next consecutive access
+    off_t cursor = regionStart;
+    off_t regionEnd = regionStart + regionSize;
+    // ~ Window of explicit readahead and the end of the range read ahead so far
+    const off_t readaheadWindow = FactorLevels.Readahead;
+    off_t readaheadEnd = regionStart;
+
+    // ~ Generators of the operation parameters and of the random offsets
+    TRandom random(seed);
+    TDistributionParams distribution;
+    distribution.Distribution = static_cast<EDistribution>(FactorLevels.Distribution);
+    distribution.ZipfTheta = FactorLevels.ZipfTheta / 100.0;
+    distribution.HotOpsPercent = FactorLevels.HotOpsPercent;
+    distribution.HotSpacePercent = FactorLevels.HotSpacePercent;
+    distribution.ParetoShape = FactorLevels.ParetoShape / 100.0;
+    TOffsetGenerator offsetGenerator(regionStart, regionSize, minSize, distribution, random.Next());
+
+    // ~ Samples the operations of the next batch from the first one on and returns the amount of bytes requested
+    // The operations before the first one are the ones carried over from the previous batch.
+    // Called between the timed batches, so that the generation cost is not measured.
+    auto nextBatch = [&](ui32 first, auto vectored) {
+        ui64 bytes = 0;
+        for (ui32 i = 0; i < BatchSize; i++) {
+            if (i >= first) {
+                isRead[i] = (random.Uniform(100) < FactorLevels.ReadPercent);
+
+                ui32 sizePercent = random.Uniform(100);
+                ui32 sizeIndex = 0;
+                while (sizeIndex + 1 < sizes.size() && sizePercent >= sizes[sizeIndex].second)
+                    sizeIndex++;
+                ui64 size = sizes[sizeIndex].first;
+                counts[i] = size;
+
+                ui64 span = size * qd;
+                if (random.Uniform(100) < FactorLevels.ConsecutivePercent) {
+                    if (cursor + (off_t)span > regionEnd)
+                        cursor = regionStart;
+                    offsets[i] = cursor;
+                    cursor += span;
+                } else {
+                    offsets[i] = offsetGenerator.Next(size, span);
+                }
+            }
+            if constexpr (decltype(vectored)::value)
+                for (ui32 j = 0; j < qd; j++)
+                    iovPtrs[i][j].iov_len = counts[i];
+            bytes += counts[i] * qd;
+        }
+        return bytes;
+    };
+    ui64 bytes = (qd > 1 ? nextBatch(0, std::true_type()) : nextBatch(0, std::false_type()));
+
+    // ~ Open-loop load parameters
+    // | Each worker takes an equal share of the target rate.
+    const bool openLoop = (FactorLevels.Rate > 0);
+    std::unique_ptr<TArrivalProcess> arrivals;
+    std::vector<TTimePoint> intendedStarts(BatchSize);
+    TTimePoint nextArrival = Nhrc::now();
+    // ~ Directions of the operations which have not arrived in time for the batch
+    std::vector<char> pendingReads(BatchSize);
+    if (openLoop) {
+        double rate = (double)FactorLevels.Rate / std::max<ui64>(FactorLevels.Threads, 1);
+        arrivals.reset(new TArrivalProcess(rate, static_cast<EArrival>(FactorLevels.Arrival), random.Next()));
+        api->SetIntendedStarts(&intendedStarts);
     }
 
+    // ~ Page faults taken by the thread before the measurement
+    auto [minorFaults, majorFaults] = ThreadPageFaults();
+    ui64 wouldBlock = api->GetWouldBlock();
+    ui64 busyTime = api->GetBusyTime();
+
+    // ~ Flusher of the writes, flushes during the warmup are not recorded
+    TFlusher flusher(fd, static_cast<EDurability>(FactorLevels.Sync), FactorLevels.SyncEvery);
+
+    // ~ Time series interval and raw samples of the worker
+    TInterval interval;
+    interval.Worker = worker;
+    std::unique_ptr<TSampleStream> samples;
+    if (Samples)
+        samples.reset(new TSampleStream(*Samples, worker));
+
     auto testStart = Nhrc::now();
     bool warmupDone = false;
-    ui64 measurements = 0;
-    while (!warmupDone || Duration(testStart, Nhrc::now()) < TestDuration
-            || latencies.size() < MinIterations) {
 
-        ssize_t bytesProcessed;
-        ui64 latency;
-        if (qd == 1) {
-            if (Pattern.IsRead)
-                std::tie(bytesProcessed, latency) = api->Read(fd, bufs, rs, offsets);
-            else
-                std::tie(bytesProcessed, latency) = api->Write(fd, bufs, rs, offsets);
-        } else if (qd > 1) {
-            if (Pattern.IsRead)
-                std::tie(bytesProcessed, latency) = api->Read(fd, iovs, qd, offsets);
-            else
-                std::tie(bytesProcessed, latency) = api->Write(fd, iovs, qd, offsets);
+    // ~ Sequential stopping: the interval is checked every 10 ms, the test duration is the time cap
+    // The interval is estimated from the batches of the measurement, whether or not the time series folds them.
+    TBatchMeans batchMeans;
+    const bool sequential = (Environment.Precision > 0);
+    const ui32 threads = std::max<ui64>(FactorLevels.Threads, 1);
+    bool workerConverged = false;
+    auto lastCheck = Nhrc::now();
+    auto running = [&]() {
+        if (!warmupDone)
+            return true;
+        auto now = Nhrc::now();
+        bool timeLeft = Duration(testStart, now) < TestDuration;
+        if (!sequential)
+            return timeLeft || result.Iterations < MinIterations;
+        if (!workerConverged && Duration(lastCheck, now) >= 10_ms
+            && batchMeans.GetCount() >= 2 * BatchMeansGroups) {
+            lastCheck = now;
+            auto [mean, halfWidth] = batchMeans.Interval();
+            if (halfWidth <= Environment.Precision * mean) {
+                workerConverged = true;
+                converged++;
+            }
         }
-        latencies.push_back(latency);
+        return timeLeft && converged.load() < threads;
+    };
 
-        // Make the data different to avoid system optimizations.
-        for (ui32 i = 0; i < BatchSize; i++) {
-            if (qd == 1) {
-                bufferPtrs[i][0]++;
-            } else if (qd > 1) {
-                for (ui32 j = 0; j < qd; j++)
-                    iovData[i * qd + j][0]++;
+    // ~ Warmup ends once the batch latencies reach the steady state
+    TSteadyStateDetector steadyState(std::max<ui32>(Warmup.SampleSize, 1), Warmup.ThresholdCoef);
+
+    // ~ Loop of the batches, instantiated for single buffers (qd == 1) and vectors of buffers (qd > 1)
+    // so that neither the submission nor the buffer mutation branches on the queue depth.
+    auto loop = [&](auto vectored) {
+        constexpr bool TVectored = decltype(vectored)::value;
+        while (running()) {
+
+            // A batch ends at the write making a flush due, so that the flush follows it and covers
+            // the writes since the previous one. Open-loop load issues only the operations which
+            // have arrived, at least one. The rest are issued first in the next batch, so the
+            // consecutive accesses stay in order. The length of a batch is the one of its buffers,
+            // so the counts and offsets of the rest stay in place.
+            ui32 batchOps = BatchSize;
+            if (ui64 writesUntilFlush = flusher.GetWritesUntilFlush(); writesUntilFlush > 0) {
+                ui64 writes = 0;
+                for (ui32 i = 0; i < BatchSize; i++)
+                    if (!isRead[i] && ++writes == writesUntilFlush) {
+                        batchOps = i + 1;
+                        break;
+                    }
+            }
+            if (openLoop) {
+                WaitUntil(nextArrival);
+                auto now = Nhrc::now();
+                ui32 limit = batchOps;
+                batchOps = 0;
+                while (batchOps < limit && (batchOps == 0 || nextArrival <= now)) {
+                    intendedStarts[batchOps] = nextArrival;
+                    nextArrival += std::chrono::nanoseconds(arrivals->NextInterval());
+                    batchOps++;
+                }
+            }
+            if (batchOps < BatchSize) {
+                bytes = 0;
+                for (ui32 i = 0; i < batchOps; i++)
+                    bytes += counts[i] * qd;
+                std::copy(isRead.begin() + batchOps, isRead.end(), pendingReads.begin());
+                isRead.resize(batchOps);
+                bufs.resize(batchOps);
+                iovs.resize(batchOps);
             }
-        }
 
-        // Set offsets for the next batch.
-        for (ui32 i = 0; i < BatchSize; i++) {
-            if (Pattern.IsConsecutive)
-                offsets[i] = (offsets[i] + rs * qd * BatchSize) % filesize;
+            // The range ahead of the cursor is extended once half of the window is consumed.
+            // The time of the readahead is spent by the worker, so it counts in the batch latency.
+            ui64 readaheadLatency = 0;
+            #if defined (__linux__)
+            if (readaheadWindow > 0) {
+                if (readaheadEnd > cursor + readaheadWindow)
+                    readaheadEnd = cursor; // the cursor wrapped around
+                if (readaheadEnd < cursor + readaheadWindow / 2) {
+                    off_t from = std::max(cursor, readaheadEnd);
+                    off_t to = std::min(cursor + readaheadWindow, regionEnd);
+                    auto start = Nhrc::now();
+                    if (to > from)
+                        readahead(fd, from, to - from);
+                    readaheadLatency = Duration(start, Nhrc::now());
+                    readaheadEnd = cursor + readaheadWindow;
+                }
+            }
+            #endif
+
+            ssize_t bytesProcessed;
+            ui64 latency;
+            if constexpr (TVectored)
+                std::tie(bytesProcessed, latency) = api->ReadWrite(fd, iovs, qd, offsets, isRead);
             else
-                offsets[i] = RandomUI32() % (filesize - rs * qd);
+                std::tie(bytesProcessed, latency) = api->ReadWrite(fd, bufs, counts, offsets, isRead);
+            latency += readaheadLatency;
+            // The flush is part of the cost of the batch, so it counts in its latency.
+            for (ui32 i = 0; i < batchOps; i++)
+                if (!isRead[i] && flusher.Write(offsets[i], counts[i] * qd))
+                    latency += flusher.Flush();
+            latencies.push_back(latency);
+            result.Bytes.push_back(bytes);
+            result.Iterations++;
+            if (warmupDone)
+                batchMeans.Add(bytes, latency);
+
+            // The vectors keep their capacity, so restoring them does not allocate.
+            // The operations not issued move to the front of the next batch.
+            ui32 carried = BatchSize - batchOps;
+            if (carried > 0) {
+                isRead.resize(BatchSize);
+                bufs.resize(BatchSize);
+                iovs.resize(BatchSize);
+                for (ui32 i = batchOps; i < BatchSize; i++) {
+                    bufs[i] = bufferPtrs[i];
+                    iovs[i] = iovPtrs[i].get();
+                }
+                std::copy(counts.begin() + batchOps, counts.end(), counts.begin());
+                std::copy(offsets.begin() + batchOps, offsets.end(), offsets.begin());
+                std::copy(pendingReads.begin(), pendingReads.begin() + carried, isRead.begin());
+            }
+
+            // Make the data different to avoid system optimizations.
+            if constexpr (TVectored) {
+                for (ui32* data : iovData)
+                    data[0]++;
+            } else {
+                for (ui32 i = 0; i < BatchSize; i++)
+                    bufferPtrs[i][0]++;
+            }
+
+            // Set operations for the next batch.
+            bytes = nextBatch(carried, vectored);
+            if (samples)
+                samples->Handoff();
+
+            if (warmupDone && TimeSeries && Duration(interval.Start, Nhrc::now()) >= TimeSeries->GetInterval())
+                FinishInterval(interval, result);
+
+            if (!warmupDone) {
+                if (steadyState.Add(latency) || Duration(testStart, Nhrc::now()) >= Warmup.MaxDuration) {
+                    warmupDone = true;
+                    barrier.Arrive();
+                    // The arrivals do not make up for the time spent at the barrier.
+                    if (openLoop)
+                        nextArrival = Nhrc::now();
+                    latencies.clear();
+                    result.Bytes.clear();
+                    result.Iterations = 0;
+                    api->SetOpLatencies(StartIntervals(interval, result));
+                    api->SetSamples(samples.get());
+                    std::tie(minorFaults, majorFaults) = ThreadPageFaults();
+                    wouldBlock = api->GetWouldBlock();
+                    busyTime = api->GetBusyTime();
+                    flusher.SetLatencies(&result.FlushLatencies);
+                    testStart = Nhrc::now();
+                }
+            }
         }
+    };
+    if (qd > 1)
+        loop(std::true_type());
+    else
+        loop(std::false_type());
+
+    if (TimeSeries)
+        FinishInterval(interval, result);
+    result.Duration = Duration(testStart, Nhrc::now());
+    result.ThroughputInterval = PerSecond(batchMeans.Interval());
+    auto [minorFaultsEnd, majorFaultsEnd] = ThreadPageFaults();
+    result.MinorFaults = minorFaultsEnd - minorFaults;
+    result.MajorFaults = majorFaultsEnd - majorFaults;
+    result.WouldBlock = api->GetWouldBlock() - wouldBlock;
+    result.BusyTime = api->GetBusyTime() - busyTime;
+
+    api->SetOpLatencies(nullptr);
+    api->SetSamples(nullptr);
+    api->SetIntendedStarts(nullptr);
+    api->Release();
+    if (samples)
+        samples->Flush();
+}
+
+
+void TBenchmark::RunTraceWorker(IAPI* api, TBufferArena& arena, ui32 fd, const TTraceReader& trace,
+                                ui32 worker, ui32 workers, TMeasurementBarrier& barrier, TWorkerResult& result) const {
+    // Operations are aligned for direct I/O, which may round the trace sizes up.
+    const ui64 granularity = Alignment.Offset;
+    const ui64 maxSize = (trace.GetMaxSize() + granularity - 1) / granularity * granularity;
+    const ui64 filesize = Environment.Filesize - Environment.Filesize % granularity;
+    if (maxSize > filesize)
+        throw std::runtime_error("TBenchmark::RunTraceWorker() error: operation size exceeds the file");
+
+    const ui64 bufAlignment = std::max<ui64>(sysconf(_SC_PAGESIZE), Alignment.Memory);
+    const ui64 bufStride = (maxSize + bufAlignment - 1) / bufAlignment * bufAlignment;
+    arena.Reserve(BatchSize * bufStride, FactorLevels.HugeBuffers);
+    std::vector<void*> bufs(BatchSize);
+    for (ui32 i = 0; i < BatchSize; i++)
+        bufs[i] = arena.Allocate(maxSize, bufAlignment);
+    api->Setup(fd, arena.Region(), GetEngineParams());
+
+    std::vector<size_t> counts;
+    std::vector<off_t> offsets;
+    std::vector<char> isRead;
+    std::vector<void*> batchBufs;
+    // ~ Original times of the records, latencies are measured from them when the pace is kept
+    std::vector<TTimePoint> intendedStarts;
+    if (FactorLevels.TraceTiming)
+        api->SetIntendedStarts(&intendedStarts);
+
+    // Records are released from memory in chunks of this many records.
+    constexpr ui64 releaseChunk = 1 << 16;
+    const ui64 traceStart = (trace.GetCount() > 0 ? trace[0].Timestamp : 0);
+    TInterval interval;
+    interval.Worker = worker;
+    // The replay has no warmup, its measurement starts right after the barrier.
+    barrier.Arrive();
+    api->SetOpLatencies(StartIntervals(interval, result));
+    std::unique_ptr<TSampleStream> samples;
+    if (Samples)
+        samples.reset(new TSampleStream(*Samples, worker));
+    api->SetSamples(samples.get());
+    const ui64 wouldBlock = api->GetWouldBlock();
+    const ui64 busyTime = api->GetBusyTime();
+    TBatchMeans batchMeans;
+    TFlusher flusher(fd, static_cast<EDurability>(FactorLevels.Sync), FactorLevels.SyncEvery);
+    flusher.SetLatencies(&result.FlushLatencies);
+    const auto replayStart = Nhrc::now();
+
+    ui64 index = worker;
+    while (index < trace.GetCount()) {
+        if (FactorLevels.TraceTiming)
+            WaitUntil(replayStart + std::chrono::nanoseconds(trace[index].Timestamp - traceStart));
+
+        // Collect the records which are due, at least one.
+        counts.clear();
+        offsets.clear();
+        isRead.clear();
+        batchBufs.clear();
+        intendedStarts.clear();
+        ui64 bytes = 0;
+        const ui64 writesUntilFlush = flusher.GetWritesUntilFlush();
+        ui64 writes = 0;
+        auto now = Nhrc::now();
+        while (index < trace.GetCount() && counts.size() < BatchSize) {
+            const TTraceRecord& record = trace[index];
+            auto due = replayStart + std::chrono::nanoseconds(record.Timestamp - traceStart);
+            if (!counts.empty() && FactorLevels.TraceTiming && due > now)
+                break;
+            if (record.Size > trace.GetMaxSize())
+                throw std::runtime_error("TBenchmark::RunTraceWorker() error: record " + std::to_string(index) +
+                                         " is larger than the trace maximum size");
+            ui64 size = (record.Size + granularity - 1) / granularity * granularity;
+            ui64 offset = record.Offset % (filesize - size + 1);
+            offsets.push_back(offset - offset % granularity);
+            counts.push_back(size);
+            isRead.push_back(record.Op == static_cast<ui32>(ETraceOp::Read));
+            batchBufs.push_back(bufs[batchBufs.size()]);
+            intendedStarts.push_back(due);
+            bytes += size;
+
+            if (worker == 0 && index % releaseChunk < workers)
+                trace.Release(index);
+            index += workers;
+            // The batch ends at the write making a flush due, the flush follows it.
+            if (!isRead.back() && ++writes == writesUntilFlush)
+                break;
+        }
+
+        auto [bytesProcessed, latency] = api->ReadWrite(fd, batchBufs, counts, offsets, isRead);
+        for (ui32 i = 0; i < counts.size(); i++)
+            if (!isRead[i] && flusher.Write(offsets[i], counts[i]))
+                latency += flusher.Flush();
+        result.Latencies.push_back(latency);
+        result.Bytes.push_back(bytes);
+        result.Iterations++;
+        batchMeans.Add(bytes, latency);
+        if (samples)
+            samples->Handoff();
+
+        if (TimeSeries && Duration(interval.Start, Nhrc::now()) >= TimeSeries->GetInterval())
+            FinishInterval(interval, result);
+    }
+    if (TimeSeries)
+        FinishInterval(interval, result);
+    result.Duration = Duration(replayStart, Nhrc::now());
+    result.ThroughputInterval = PerSecond(batchMeans.Interval());
+    result.WouldBlock = api->GetWouldBlock() - wouldBlock;
+    result.BusyTime = api->GetBusyTime() - busyTime;
+
+    api->SetOpLatencies(nullptr);
+    api->SetSamples(nullptr);
+    api->SetIntendedStarts(nullptr);
+    api->Release();
+    if (samples)
+        samples->Flush();
+}
+
+
+void TBenchmark::RunWalWorker(IAPI* api, TBufferArena& arena, TGroupCommit& log, ui32 worker,
+                              TMeasurementBarrier& barrier, TWorkerResult& result) const {
+    // The other producers stop waiting for this one whichever way it finishes.
+    struct TLeave {
+        TGroupCommit& Log;
+        ~TLeave() { Log.Leave(); }
+    } leave{log};
+
+    const ui64 size = FactorLevels.RequestSize;
+    if (size == 0 || size > Environment.Filesize)
+        throw std::runtime_error("TBenchmark::RunWalWorker() error: record size must be in (0, filesize]");
+    const ui64 bufAlignment = std::max<ui64>(sysconf(_SC_PAGESIZE), Alignment.Memory);
+    arena.Reserve((size + bufAlignment - 1) / bufAlignment * bufAlignment, FactorLevels.HugeBuffers);
+    std::vector<void*> bufs = {arena.Allocate(size, bufAlignment)};
+    std::vector<off_t> offsets(1);
+    const int fd = log.GetFd();
+    api->Setup(fd, arena.Region(), GetEngineParams());
+
+    TInterval interval;
+    interval.Worker = worker;
+    THistogram* opLatencies = nullptr;
+    std::unique_ptr<TSampleStream> samples;
+    if (Samples)
+        samples.reset(new TSampleStream(*Samples, worker));
+    auto [minorFaults, majorFaults] = ThreadPageFaults();
 
-        if (!warmupDone) {
-            if (latencies.size() < Warmup.SampleSize)
-                continue;
-            std::vector<ui64> warmupLatencies(Warmup.SampleSize);
-            for (ui32 i = 0; i < Warmup.SampleSize; i++)
-                warmupLatencies[i] = latencies[latencies.size() - 1 - i];
-            auto [mean, std] = Statistics(warmupLatencies);
-            if (Duration(testStart, Nhrc::now()) >= Warmup.MaxDuration
-                || std <= Warmup.ThresholdCoef * mean) {
-                // cout << "Warmup criterion: " << (std <= Warmup.ThresholdCoef * mean) << endl;
-                warmupDone = true;
-                latencies.clear();
-                testStart = Nhrc::now();
+    // The workload does not touch the test file, so the producers pass the barrier before their warmup:
+    // one waiting there during the warmup of the others would keep their groups from committing.
+    barrier.Arrive();
+    TSteadyStateDetector steadyState(std::max<ui32>(Warmup.SampleSize, 1), Warmup.ThresholdCoef);
+    TBatchMeans batchMeans;
+    auto testStart = Nhrc::now();
+    bool warmupDone = false;
+    while (!warmupDone || Duration(testStart, Nhrc::now()) < TestDuration || result.Iterations < MinIterations) {
+        auto batchStart = Nhrc::now();
+        for (ui32 i = 0; i < BatchSize; i++) {
+            offsets[0] = log.Reserve(size);
+            auto start = Nhrc::now();
+            api->Write(fd, bufs, size, offsets);
+            log.Commit(warmupDone ? &result.FlushLatencies : nullptr);
+            auto end = Nhrc::now();
+            if (opLatencies) {
+                opLatencies->Add(Duration(start, end));
+                if (samples)
+                    samples->Add(end, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+                                 offsets[0], false);
             }
+            static_cast<ui32*>(bufs[0])[0]++;
+        }
+        ui64 latency = Duration(batchStart, Nhrc::now());
+        result.Latencies.push_back(latency);
+        result.Bytes.push_back(size * BatchSize);
+        result.Iterations++;
+        if (warmupDone)
+            batchMeans.Add(size * BatchSize, latency);
+        if (samples)
+            samples->Handoff();
+
+        if (warmupDone && TimeSeries && Duration(interval.Start, Nhrc::now()) >= TimeSeries->GetInterval())
+            FinishInterval(interval, result);
+
+        if (!warmupDone && (steadyState.Add(latency) || Duration(testStart, Nhrc::now()) >= Warmup.MaxDuration)) {
+            warmupDone = true;
+            result.Latencies.clear();
+            result.Bytes.clear();
+            result.Iterations = 0;
+            opLatencies = StartIntervals(interval, result);
+            std::tie(minorFaults, majorFaults) = ThreadPageFaults();
+            testStart = Nhrc::now();
         }
     }
-    if (MinIterations == 0)
-        MinIterations = latencies.size();
+    if (TimeSeries)
+        FinishInterval(interval, result);
+    result.Duration = Duration(testStart, Nhrc::now());
+    result.ThroughputInterval = PerSecond(batchMeans.Interval());
+    auto [minorFaultsEnd, majorFaultsEnd] = ThreadPageFaults();
+    result.MinorFaults = minorFaultsEnd - minorFaults;
+    result.MajorFaults = majorFaultsEnd - majorFaults;
 
-    close(fd);
-    unlink(Environment.Filepath.c_str());
-    return latencies;
+    api->Release();
+    if (samples)
+        samples->Flush();
 }
 
 
-ui32 TBenchmark::PrepareEnvironment() const {
-    const char* filepath = Environment.Filepath.c_str();
-    // Removes the file if it exists and the Unlink flag is set
-    if (Environment.Unlink)
-        unlink(filepath);
+THistogram* TBenchmark::StartIntervals(TInterval& interval, TWorkerResult& result) const {
+    interval.RunStart = interval.Start = Nhrc::now();
+    interval.OpLatencies.Clear();
+    interval.FirstBatch = result.Latencies.size();
+    return (TimeSeries ? &interval.OpLatencies : &result.OpLatencies);
+}
+
+
+void TBenchmark::FinishInterval(TInterval& interval, TWorkerResult& result) const {
+    auto now = Nhrc::now();
+    TIntervalRecord record;
+    record.Worker = interval.Worker;
+    record.Start = Duration(interval.RunStart, interval.Start);
+    record.Duration = Duration(interval.Start, now);
+    record.OpLatencies = &interval.OpLatencies;
+
+    // The batches of the interval become a single sample of the same throughput.
+    ui64 latency = 0;
+    for (ui64 i = interval.FirstBatch; i < result.Latencies.size(); i++) {
+        latency += result.Latencies[i];
+        record.Bytes += result.Bytes[i];
+    }
+    TimeSeries->Write(record);
+    result.Latencies.resize(interval.FirstBatch);
+    result.Bytes.resize(interval.FirstBatch);
+    if (record.Bytes > 0) {
+        result.Latencies.push_back(latency);
+        result.Bytes.push_back(record.Bytes);
+    }
+
+    result.OpLatencies.Merge(interval.OpLatencies);
+    interval.OpLatencies.Clear();
+    interval.Start = now;
+    interval.FirstBatch = result.Latencies.size();
+}
+
+
+TEngineParams TBenchmark::GetEngineParams() const {
+    TEngineParams engineParams;
+    engineParams.QueueDepth = FactorLevels.QueueDepth;
+    engineParams.DirectIO = FactorLevels.DirectIO;
+    engineParams.SqPoll = FactorLevels.SqPoll;
+    engineParams.IoPoll = FactorLevels.IoPoll;
+    engineParams.FixedBuffers = FactorLevels.FixedBuffers;
+    engineParams.FixedFiles = FactorLevels.FixedFiles;
+    engineParams.MapPopulate = FactorLevels.MapPopulate;
+    engineParams.MapAdvice = FactorLevels.MapAdvice;
+    engineParams.MapHugePages = FactorLevels.MapHugePages;
+    engineParams.MapSync = FactorLevels.MapSync;
+    engineParams.HighPriority = FactorLevels.HighPriority;
+    engineParams.NoWait = FactorLevels.NoWait;
+    engineParams.DSync = FactorLevels.DSync;
+    engineParams.Append = FactorLevels.Append;
+    return engineParams;
+}
+
 
+ui32 TBenchmark::PrepareEnvironment() {
+    const char* filepath = Environment.Filepath.c_str();
     if (Environment.PreparationScript != "") {
         ui32 exitStatus;
         ExecuteCommand(Environment.PreparationScript.c_str(), exitStatus);
     }
 
+    // The file is laid out once and reused by the following runs
+    if (Environment.Unlink)
+        Fixtures->Prepare(Environment.Filepath, Environment.Filesize, Environment.FillMode);
+
     i32 fd;
     auto flags = O_RDWR | O_CREAT;
 
@@ -236,38 +1107,44 @@ ui32 TBenchmark::PrepareEnvironment() const {
         flags |= F_NOCACHE;
     #endif
 
+    if (static_cast<EDurability>(FactorLevels.Sync) == EDurability::DSync)
+        flags |= O_DSYNC;
+
     // S_IRWXU = write permission for the file owner
     if ((fd = open(filepath, flags, S_IRWXU)) == -1)
         throw std::runtime_error("Couldn't not open file \"" + Environment.Filepath + "\"");
 
-    ui64 rs = 64_KB;
-    ui64 qd = 8;
-
-    srand(time(nullptr));
-
-    // Fill file with random data
-    if (Environment.Unlink) {
-        ui64 iterations = std::ceil((ld)Environment.Filesize / (rs * qd));
-        ui64 bufSize = std::ceil((ld)rs / sizeof(ui32));
-
-        std::unique_ptr<struct iovec[]> iovPtr(new struct iovec[qd]);
-        std::vector<std::unique_ptr<ui32[]>> iovData(qd);
-
-        for (ui32 i = 0; i < qd; i++) {
-            iovData[i] = std::unique_ptr<ui32[]>(new ui32[bufSize]);
-            iovPtr[i].iov_base = iovData[i].get();
-            iovPtr[i].iov_len = rs;
-        }
+    try {
+        SetFileAdvice(fd, static_cast<EFileAdvice>(FactorLevels.FileAdvice));
+    } catch (...) {
+        close(fd);
+        throw;
+    }
 
-        off_t offset = 0;
+    Alignment = {1, 1};
+    if (dio) {
+        Alignment = GetDirectIOAlignment(fd);
+        std::vector<ui64> sizes = {FactorLevels.RequestSize};
+        for (auto [size, percent] : Pattern.RequestSizes)
+            sizes.push_back(size);
+        for (ui64 size : sizes)
+            if (size % Alignment.Offset != 0) {
+                close(fd);
+                throw std::runtime_error("Operation size " + std::to_string(size) + " is not a multiple of "
+                                         + std::to_string(Alignment.Offset) + " bytes required by direct I/O");
+            }
+    }
 
-        IAPI* api = Factory->Construct();
-        for (ui64 i = 0; i < iterations; i++) {
-            api->Write(fd, {iovPtr.get()}, qd, {offset});
-            for (ui32 j = 0; j < qd; j++)
-                iovData[j][0]++;
-            offset += rs * qd;
+    // The readahead is changed last: from here on Benchmark() restores it however the run ends
+    if (FactorLevels.BlockReadahead > 0) {
+        try {
+            SavedBlockReadahead = SetBlockReadahead(fd, FactorLevels.BlockReadahead);
+        } catch (...) {
+            close(fd);
+            throw;
         }
+        if (SavedBlockReadahead == -1)
+            std::cerr << "BLKRA ignored: \"" << Environment.Filepath << "\" is not a block device\n";
     }
 
     return fd;
@@ -6,28 +6,116 @@
 
 #include "globals.h"
 #include "api.h"
+#include "arena.h"
+#include "fixture.h"
+#include "distribution.h"
+#include "trace.h"
+#include "timeseries.h"
+#include "samples.h"
+#include "warmup.h"
+#include "durability.h"
+#include "wal.h"
+#include "cache.h"
 
 #include <vector>
 #include <string>
+#include <memory> // std::shared_ptr
+#include <atomic>
 
 
 // ~ Function that estimates a (mean, std) pair from sample
 std::pair<ui64, ui64> Statistics(const std::vector<ui64>& sample);
 
+// ~ Number of groups of the batch means method
+constexpr ui32 BatchMeansGroups = 20;
+
+// ~ Estimates the mean of a series of autocorrelated observations and the half-width of its 95% confidence interval
+// Nonoverlapping batch means: the series is cut into BatchMeansGroups consecutive groups (fewer for short
+// series), whose means are nearly independent. The mean of a group is the sum of its values divided by
+// the sum of their weights (weights are 1 if none are given). The half-width is infinite for less than 2 values.
+std::pair<ld, ld> BatchMeansInterval(const std::vector<ui64>& values, const std::vector<ui64>& weights = {});
+
+// ~ Batch means of a weighted series accumulated in a bounded number of groups
+// Values and weights of GroupSize consecutive observations are summed into a group. Once there are
+// 2 * BatchMeansGroups groups, neighbouring ones are merged and the group size doubles, so the memory
+// does not depend on the length of the series and the groups stay equally sized.
+// Unlike the batch latencies of a worker, the groups are not folded by the time series intervals.
+class TBatchMeans {
+public:
+    TBatchMeans();
+
+    void Add(ui64 value, ui64 weight);
+
+    // ~ Returns the number of observations added
+    ui64 GetCount() const { return Count; }
+
+    // ~ Mean of the values per weight and the half-width of its 95% confidence interval (see BatchMeansInterval)
+    // Only the full groups are taken into account.
+    std::pair<ld, ld> Interval() const;
+
+private:
+    std::vector<ui64> Values;
+    std::vector<ui64> Weights;
+    ui64 GroupSize = 1;
+    ui64 Count = 0;
+    // ~ Sums of the group being filled and the number of observations in it
+    ui64 Value = 0;
+    ui64 Weight = 0;
+    ui64 Filled = 0;
+};
+
+// ~ Returns the minor and major page faults taken by the calling thread so far
+// Falls back to the whole process where per-thread usage is not available.
+std::pair<ui64, ui64> ThreadPageFaults();
+
 
 // ~ Class describing the workload pattern
+// Each operation is sampled independently: it is a read with ReadPercent probability
+// and accesses memory consecutively with ConsecutivePercent probability.
+// The ratios are the defaults of the "READ" and "SEQ" factors.
+// Random offsets follow the access distribution, its parameters are the defaults
+// of the "DIST", "THETA", "HOTOPS", "HOTSPACE" and "PARETO" factors.
 struct TPattern {
-    // ~ Flag showing that the memory access is _consecutive_ (instead of _random_)
-    bool IsConsecutive = false;
-    // ~ Flag showing that the memory access operation is _read_ (instead of _write_)
-    bool IsRead = false;
+    // ~ Percentage of _consecutive_ memory accesses (the rest are _random_)
+    ui64 ConsecutivePercent = 0;
+    // ~ Percentage of _read_ operations (the rest are _write_)
+    ui64 ReadPercent = 0;
+    // ~ Distribution of operation sizes as (size in bytes, percentage) pairs
+    // Operations are of the RS factor size if the distribution is empty.
+    std::vector<std::pair<ui64, ui64>> RequestSizes;
+    // ~ Distribution of random offsets (see EDistribution)
+    ui64 Distribution = 0;
+    // ~ Zipfian skew (in hundredths)
+    ui64 ZipfTheta = 99;
+    // ~ Percentage of operations accessing the hot set and the percentage of the file it covers
+    ui64 HotOpsPercent = 80;
+    ui64 HotSpacePercent = 20;
+    // ~ Pareto shape (in hundredths)
+    ui64 ParetoShape = 116;
+    // ~ Path to the trace to be replayed instead of the synthetic workload (empty if none)
+    std::string TracePath;
+    // ~ Flag to issue the trace operations at their original times (as fast as possible otherwise)
+    // The default of the "TRACETIME" factor.
+    ui64 TraceTiming = 0;
 };
 
 
+// ~ Names of the factors accepted by TFactorLevels::SetLevel() and GetLevel()
+extern const std::vector<std::string> FactorNames;
+
+// ~ Returns true if the levels of the factor are categories (e.g. engines) rather than ordered values
+bool IsCategorical(const std::string& factor);
+
+
 // ~ Class storing factor levels
 // Characterizes a point in the factor space
 class TFactorLevels {
 public:
+    TFactorLevels() = default;
+
+    // ~ Takes the default workload ratios from the pattern
+    explicit TFactorLevels(const TPattern& pattern);
+
     void SetLevel(const std::string& factor, ui64 level);
 
     ui64 GetLevel(const std::string& factor) const;
@@ -40,17 +128,83 @@ public:
     ui64 QueueDepth = 8;
     // ~ Flag to skip cache
     ui64 DirectIO = 0;
+    // ~ I/O engine performing the operations (see EEngine)
+    // 0 = POSIX, 1 = io_uring, 2 = Linux AIO, 3 = mmap, 4 = null (no I/O, measures the harness), 5 = preadv2.
+    ui64 Engine = 0;
+    // ~ Flags of the io_uring polling modes
+    // Kernel-side submission polling and completion polling (requires DirectIO).
+    ui64 SqPoll = 0;
+    ui64 IoPoll = 0;
+    // ~ Flags to register the buffers and the file descriptor with the engine up front
+    ui64 FixedBuffers = 0;
+    ui64 FixedFiles = 0;
+    // ~ Number of worker threads, each with its own API object and buffers
+    ui64 Threads = 1;
+    // ~ Flag showing that the workers access the whole file
+    // Otherwise each worker accesses its own disjoint region of the file.
+    ui64 SharedFile = 0;
+    // ~ Percentage of read operations
+    ui64 ReadPercent = 0;
+    // ~ Percentage of consecutive memory accesses
+    ui64 ConsecutivePercent = 0;
+    // ~ Flag to back the buffers with huge pages (MAP_HUGETLB)
+    ui64 HugeBuffers = 0;
+    // ~ Parameters of the file mapping used by the mmap engine
+    // Populate flag, access advice (see EMapAdvice), huge pages flag (tmpfs only) and msync() after writes flag.
+    ui64 MapPopulate = 0;
+    ui64 MapAdvice = 0;
+    ui64 MapHugePages = 0;
+    ui64 MapSync = 0;
+    // ~ RWF_* flags of the preadv2 engine (see TEngineParams)
+    ui64 HighPriority = 0;
+    ui64 NoWait = 0;
+    ui64 DSync = 0;
+    ui64 Append = 0;
+    // ~ Way of making the writes durable (see EDurability) and the number of writes per flush
+    ui64 Sync = 0;
+    ui64 SyncEvery = 1;
+    // ~ Append workload with group commit (see EWalMode), records are of RS size
+    // Number of records pending before a flush (at most the number of threads wait for one)
+    // and the flag to preallocate the log.
+    ui64 Wal = 0;
+    ui64 GroupSize = 1;
+    ui64 Preallocate = 0;
+    // ~ State of the page cache of the file set after the warmup, before the measurement (see ECacheState)
+    // and the percentage of the file warmed in the partial state.
+    ui64 CacheState = 0;
+    ui64 WarmPercent = 50;
+    // ~ Readahead hints: access advice for the file (see EFileAdvice), window of explicit readahead(2)
+    // ahead of the consecutive cursor (in bytes, 0 = none) and readahead of the block device
+    // the test file is (in KB, 0 = as is).
+    ui64 FileAdvice = 0;
+    ui64 Readahead = 0;
+    ui64 BlockReadahead = 0;
+    // ~ Access distribution of random offsets and its parameters (see TPattern)
+    ui64 Distribution = 0;
+    ui64 ZipfTheta = 99;
+    ui64 HotOpsPercent = 80;
+    ui64 HotSpacePercent = 20;
+    ui64 ParetoShape = 116;
+    // ~ Flag to replay the trace at its original pace (see TPattern)
+    ui64 TraceTiming = 0;
+    // ~ Target rate of operations of all the workers (per second) and its arrival process (see EArrival)
+    // The load is open-loop if the rate is set: operations are issued at their arrival times
+    // regardless of the completions, latencies are measured from the arrival times.
+    // 0 means closed-loop load, each batch is issued as soon as the previous one completes.
+    ui64 Rate = 0;
+    ui64 Arrival = 0;
 };
 
 
 // ~ Class storing warmup parameters
 struct TWarmupParams {
-    // ~ Coef used in warmup completion criterion
-    // The criterion: std <= ThresholdCoef * mean.
+    // ~ Coef used in warmup completion criterion (see TSteadyStateDetector)
+    // The criterion: the means of the last rounds of batch latencies lie within the range of
+    // ThresholdCoef * average and drift across the rounds by at most half of that.
     double ThresholdCoef;
     // ~ Maximum warmup duration (in microseconds)
     ui64 MaxDuration;
-    // ~ Size of the latencies sample used in statistics calculation
+    // ~ Number of batch latencies in a round
     ui32 SampleSize;
 };
 
@@ -59,27 +213,137 @@ struct TWarmupParams {
 struct TEnvironmentParams {
     std::string Filepath; // ~ Path to the file to be tested
     ui64 Filesize; // ~ Size of the file to be tested (in bytes)
-    bool Unlink = true; // ~ Flag showing that the file should be removed if it exists
+    bool Unlink = true; // ~ Flag showing that the file should be laid out anew (an existing file is used as is otherwise)
+    EFillMode FillMode = EFillMode::Data; // ~ Way of laying out the file
+    bool InvalidateFixtures = false; // ~ Flag showing that the file should be laid out anew between replays
+    ui64 Seed = 0; // ~ Seed of the workload generators (a random one is taken and logged if 0)
+    ETimer Timer = ETimer::Default; // ~ Source of the time measurements
+    bool Calibrate = false; // ~ Flag to measure the harness overhead of each test against the null engine
+    double Precision = 0; // ~ Relative half-width of the throughput confidence interval at which runs stop (0 = fixed duration)
+    std::string TimeSeriesPath = ""; // ~ File receiving the per-interval time series (empty if none)
+    ui64 TimeSeriesInterval = 1_s; // ~ Interval of the time series (in microseconds)
+    std::string SamplesPath = ""; // ~ File receiving the raw samples of all the operations (empty if none)
     std::string PreparationScript = ""; // ~ Script called at the beginning of preparation
 };
 
 
+// ~ Class storing the result of a single worker thread
+// Aligned to a cache line so that workers recording latencies do not share one.
+struct alignas(64) TWorkerResult {
+    // ~ Latencies of batches (in microseconds)
+    // With the time series enabled the batches of each finished interval are folded
+    // into a single sample, so that the memory does not grow with the test duration.
+    std::vector<ui64> Latencies;
+    // ~ Amount of bytes requested by each batch
+    std::vector<ui64> Bytes;
+    // ~ Number of batches performed (excluding warmup)
+    ui64 Iterations = 0;
+    // ~ Latencies of single operations (in microseconds)
+    // An operation is a request completion reported by the engine.
+    THistogram OpLatencies;
+    // ~ Duration of the measurement excluding warmup (in microseconds)
+    ui64 Duration = 0;
+    // ~ Total duration of the timed batches during the measurement (in nanoseconds)
+    ui64 BusyTime = 0;
+    // ~ Page faults taken by the worker thread during the measurement
+    ui64 MinorFaults = 0;
+    ui64 MajorFaults = 0;
+    // ~ Operations which would have blocked under RWF_NOWAIT during the measurement
+    ui64 WouldBlock = 0;
+    // ~ Latencies of the flushes made during the measurement (in microseconds)
+    THistogram FlushLatencies;
+    // ~ Mean throughput of the batches and the half-width of its 95% confidence interval (in bytes per second)
+    // The interval the stopping rule checks, computed over the whole measurement.
+    std::pair<ld, ld> ThroughputInterval = {0, 0};
+};
+
+
+// ~ Class storing the result of a single benchmark run
+struct TBenchmarkResult {
+    // ~ Results of each worker thread
+    std::vector<TWorkerResult> Workers;
+    // ~ Latencies of single operations of all the workers
+    THistogram OpLatencies;
+    // ~ Page faults taken by all the workers during the measurement
+    ui64 MinorFaults = 0;
+    ui64 MajorFaults = 0;
+    // ~ Operations of all the workers which would have blocked under RWF_NOWAIT
+    ui64 WouldBlock = 0;
+    // ~ Latencies of the flushes of all the workers
+    THistogram FlushLatencies;
+    // ~ Fraction of the file resident in the page cache when the measurement started
+    ld Resident = 0;
+    // ~ Mean throughput of all the workers and the half-width of its 95% confidence interval (in bytes per second)
+    // The workers are independent, so the means add up and so do the squares of the half-widths.
+    std::pair<ld, ld> ThroughputInterval = {0, 0};
+};
+
+
 // ~ Main class
 // Intended for benchmarking a single point in the factor space
 class TBenchmark {
 public:
     TBenchmark(TPattern pattern, const TFactorLevels& factorLevels,
                const TWarmupParams& warmup, const TEnvironmentParams& environment,
-               ui64 testDuration, ui32 batchSize, IAPIFactory* factory);
+               ui64 testDuration, ui32 batchSize, IAPIFactory* factory,
+               std::shared_ptr<TFixtureCache> fixtures = std::make_shared<TFixtureCache>(),
+               std::shared_ptr<TTimeSeriesWriter> timeSeries = nullptr,
+               std::shared_ptr<TSampleWriter> samples = nullptr);
 
     // ~ Main benchmarking method
     // Performs a single benchmark.
-    // Returns a vector of latencies.
-    std::vector<ui64> Benchmark();
+    // Returns batch latencies and statistics of single operation latencies.
+    TBenchmarkResult Benchmark();
 
 private:
     // ~ Method that prepares the environment
-    ui32 PrepareEnvironment() const;
+    // Takes the file from the fixture cache and validates direct I/O alignment of the operations.
+    ui32 PrepareEnvironment();
+
+    // ~ Method performing the benchmark loop of a single worker thread
+    // Operations access the [regionStart, regionStart + regionSize) region of the file.
+    // The workload of the worker is determined by the seed.
+    // With a precision set the worker adds itself to converged once the confidence interval
+    // of its throughput is narrow enough, all the workers stop when every one of them has converged.
+    // The interval is checked every 10 ms once there are 2 * BatchMeansGroups batches.
+    void RunWorker(IAPI* api, TBufferArena& arena, ui32 fd, off_t regionStart, ui64 regionSize,
+                   ui32 worker, ui64 seed, std::atomic<ui32>& converged, TMeasurementBarrier& barrier,
+                   TWorkerResult& result) const;
+
+    // ~ Method replaying the records worker, worker + workers, ... of the trace
+    // Each batch holds up to BatchSize records which are due. There is no warmup,
+    // the measurement covers the whole trace.
+    void RunTraceWorker(IAPI* api, TBufferArena& arena, ui32 fd, const TTraceReader& trace,
+                        ui32 worker, ui32 workers, TMeasurementBarrier& barrier, TWorkerResult& result) const;
+
+    // ~ Method appending records to the log as a producer of the append workload
+    // Each record is committed before the next one is appended, the latency of a single operation
+    // is the commit latency of a record (from the start of its write to the end of the flush covering it).
+    // Runs stop at the test duration, the precision is not used.
+    void RunWalWorker(IAPI* api, TBufferArena& arena, TGroupCommit& log, ui32 worker, TMeasurementBarrier& barrier,
+                      TWorkerResult& result) const;
+
+    // ~ Returns the engine parameters given by the factor levels
+    TEngineParams GetEngineParams() const;
+
+    // ~ State of the current time series interval of a worker
+    struct TInterval {
+        ui32 Worker = 0;
+        // ~ End of the warmup and start of the interval
+        TTimePoint RunStart;
+        TTimePoint Start;
+        // ~ Latencies of the operations of the interval, merged into the worker result when it ends
+        THistogram OpLatencies;
+        // ~ Index of the first batch sample of the interval
+        ui64 FirstBatch = 0;
+    };
+
+    // ~ Starts the time series of a worker after the warmup
+    // Returns the histogram receiving the latencies of single operations.
+    THistogram* StartIntervals(TInterval& interval, TWorkerResult& result) const;
+
+    // ~ Writes the record of the interval, folds its batch samples into one and starts the next interval
+    void FinishInterval(TInterval& interval, TWorkerResult& result) const;
 
 // ~ Benchmark parameters stored for multiple use
 private:
@@ -95,8 +359,22 @@ private:
     // | Stores the objects created.
     IAPIFactory* Factory;
     // ~ Min amount of iterations to be performed during testing (excluding warmup)
-    // Parameter is set in the first benchmark run.
+    // Parameter is set in the first benchmark run. Not used by runs with a precision set.
     ui64 MinIterations = 0;
+    // ~ Alignment of buffer addresses and file offsets required by the file
+    // Both are 1 unless DirectIO is set.
+    TDirectIOAlignment Alignment = {1, 1};
+    // ~ Readahead of the block device before the run (in KB, -1 if it was not changed)
+    int64_t SavedBlockReadahead = -1;
+    // ~ Buffer arenas of the workers
+    // | Kept between runs so that the buffers are mapped once.
+    std::vector<std::shared_ptr<TBufferArena>> Arenas;
+    // ~ Cache of prepared test files shared by the benchmarks of an experiment
+    std::shared_ptr<TFixtureCache> Fixtures;
+    // ~ Writer of the time series (nullptr if disabled)
+    std::shared_ptr<TTimeSeriesWriter> TimeSeries;
+    // ~ Writer of the raw samples (nullptr if disabled)
+    std::shared_ptr<TSampleWriter> Samples;
 };
 
 
@@ -0,0 +1,171 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __CACHE__CPP__
+#define __CACHE__CPP__
+
+
+#include "cache.h"
+
+#include <sys/stat.h> // fstat()
+#include <sys/mman.h> // mmap(), mincore(), munmap()
+#include <sys/ioctl.h> // ioctl()
+#include <fcntl.h> // open(), posix_fadvise()
+#include <unistd.h> // pread(), fdatasync(), close(), sysconf()
+#include <cerrno> // errno
+#include <cstring> // strerror()
+#include <stdexcept> // runtime_error
+#include <vector>
+
+#if defined (__linux__)
+#include <linux/fs.h> // BLKRAGET, BLKRASET
+#endif
+
+
+// ~ Chunks of the file read into the cache (and the granularity of the partial state)
+static constexpr ui64 CacheChunk = 64 * 1024;
+
+
+void SetCacheState(const std::string& filepath, ECacheState state, ui32 warmPercent) {
+    if (state == ECacheState::AsIs)
+        return;
+    if (state != ECacheState::Cold && state != ECacheState::Warm && state != ECacheState::Partial)
+        throw std::runtime_error("SetCacheState() error: cache state " + std::to_string(static_cast<ui32>(state)) +
+                                 " not supported");
+    if (warmPercent > 100)
+        throw std::runtime_error("SetCacheState() error: warm percentage must be in [0, 100]");
+
+    int fd = open(filepath.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        if (fd != -1)
+            close(fd);
+        throw std::runtime_error("SetCacheState() error: couldn't open file \"" + filepath + "\"");
+    }
+    ui64 filesize = st.st_size;
+
+    // Dirty pages are not dropped, so the file is flushed first.
+    // Every state but Warm starts from the cold cache, so that Partial warms exactly its share.
+    if (state != ECacheState::Warm) {
+        #if defined (__linux__)
+        bool dropped = (fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0);
+        #else
+        bool dropped = false;
+        errno = ENOTSUP;
+        #endif
+        if (!dropped) {
+            close(fd);
+            throw std::runtime_error(std::string("SetCacheState() error: couldn't drop the cache: ") + strerror(errno));
+        }
+    }
+
+    if (state == ECacheState::Warm)
+        warmPercent = 100;
+    if (state != ECacheState::Cold && warmPercent > 0) {
+        // Readahead would bring in the chunks around the ones read.
+        #if defined (__linux__)
+        if (warmPercent < 100)
+            posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+        #endif
+        std::vector<char> buffer(CacheChunk);
+        ui64 chunks = (filesize + CacheChunk - 1) / CacheChunk;
+        for (ui64 i = 0; i < chunks; i++) {
+            // The i-th chunk is read if it raises the number of chunks read to the next whole percent.
+            if ((i + 1) * warmPercent / 100 == i * warmPercent / 100)
+                continue;
+            if (pread(fd, buffer.data(), CacheChunk, i * CacheChunk) == -1) {
+                close(fd);
+                throw std::runtime_error(std::string("SetCacheState() pread() error: ") + strerror(errno));
+            }
+        }
+    }
+    close(fd);
+}
+
+
+ld ResidentFraction(const std::string& filepath) {
+    int fd = open(filepath.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        if (fd != -1)
+            close(fd);
+        throw std::runtime_error("ResidentFraction() error: couldn't open file \"" + filepath + "\"");
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    // Mapping without touching the pages does not change their residency.
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error(std::string("ResidentFraction() mmap() error: ") + strerror(errno));
+    const ui64 pageSize = sysconf(_SC_PAGESIZE);
+    const ui64 pages = (st.st_size + pageSize - 1) / pageSize;
+    #if defined (__APPLE__)
+    std::vector<char> residency(pages);
+    #else
+    std::vector<unsigned char> residency(pages);
+    #endif
+    int result = mincore(mapping, st.st_size, residency.data());
+    munmap(mapping, st.st_size);
+    if (result == -1)
+        throw std::runtime_error(std::string("ResidentFraction() mincore() error: ") + strerror(errno));
+
+    ui64 resident = 0;
+    for (auto page : residency)
+        resident += (page & 1);
+    return static_cast<ld>(resident) / pages;
+}
+
+
+void SetFileAdvice(int fd, EFileAdvice advice) {
+    #if defined (__linux__)
+    int value = POSIX_FADV_NORMAL;
+    switch (advice) {
+    case EFileAdvice::Normal:
+        break;
+    case EFileAdvice::Sequential:
+        value = POSIX_FADV_SEQUENTIAL;
+        break;
+    case EFileAdvice::Random:
+        value = POSIX_FADV_RANDOM;
+        break;
+    case EFileAdvice::NoReuse:
+        value = POSIX_FADV_NOREUSE;
+        break;
+    default:
+        throw std::runtime_error("SetFileAdvice() error: advice " + std::to_string(static_cast<ui32>(advice)) +
+                                 " not supported");
+    }
+    int result = posix_fadvise(fd, 0, 0, value);
+    if (result != 0)
+        throw std::runtime_error(std::string("SetFileAdvice() posix_fadvise() error: ") + strerror(result));
+    #else
+    if (advice != EFileAdvice::Normal)
+        throw std::runtime_error("SetFileAdvice() error: posix_fadvise() is only supported on Linux");
+    #endif
+}
+
+
+int64_t SetBlockReadahead(int fd, ui64 readahead) {
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISBLK(st.st_mode))
+        return -1;
+    #if defined (__linux__)
+    // The device readahead is kept in 512-byte sectors.
+    long previous = 0;
+    if (ioctl(fd, BLKRAGET, &previous) == -1 || ioctl(fd, BLKRASET, readahead * 2) == -1)
+        throw std::runtime_error(std::string("SetBlockReadahead() ioctl() error: ") + strerror(errno));
+    return previous / 2;
+    #else
+    throw std::runtime_error("SetBlockReadahead() error: BLKRASET is only supported on Linux");
+    #endif
+}
+
+
+
+
+
+
+#endif
@@ -0,0 +1,55 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __CACHE__H__
+#define __CACHE__H__
+
+
+#include "globals.h"
+
+#include <string>
+
+
+// ~ States of the page cache of the test file selectable through the "CACHE" factor
+enum class ECacheState : ui32 {
+    // ~ The cache is left as the previous test left it
+    AsIs = 0,
+    // ~ The file is flushed and dropped from the cache (POSIX_FADV_DONTNEED)
+    Cold = 1,
+    // ~ The whole file is read into the cache
+    Warm = 2,
+    // ~ The file is dropped and then the given percentage of it, spread evenly, is read into the cache
+    Partial = 3,
+};
+
+
+// ~ Access advices for the test file selectable through the "FADV" factor (posix_fadvise())
+enum class EFileAdvice : ui32 {
+    Normal = 0,
+    Sequential = 1,
+    Random = 2,
+    NoReuse = 3,
+};
+
+
+// ~ Brings the page cache of the file into the state
+// Works in-process through a buffered descriptor of its own, so that neither root nor
+// a preparation script is needed and the descriptors of the test are not affected.
+void SetCacheState(const std::string& filepath, ECacheState state, ui32 warmPercent);
+
+// ~ Returns the fraction of the pages of the file resident in the page cache
+// Checked with mincore() on a mapping of the file, 0 for an empty file.
+ld ResidentFraction(const std::string& filepath);
+
+// ~ Gives the access advice for the whole file open at fd
+void SetFileAdvice(int fd, EFileAdvice advice);
+
+// ~ Sets the readahead of the block device open at fd (in KB, BLKRASET) and returns the previous one
+// Returns -1 and changes nothing if fd is not a block device. Setting it usually requires root.
+int64_t SetBlockReadahead(int fd, ui64 readahead);
+
+
+
+
+
+
+#endif
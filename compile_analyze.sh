@@ -0,0 +1,3 @@
+#!/bin/sh
+
+g++ analyze.cpp samples.cpp histogram.cpp globals.cpp -o analyze -std=c++17 -g -pthread
@@ -1,3 +1,3 @@
 #!/bin/sh
 
-g++ main.cpp benchmark.cpp api.cpp globals.cpp test.cpp -o run -std=c++17 -g
+g++ main.cpp benchmark.cpp api.cpp globals.cpp histogram.cpp arena.cpp fixture.cpp distribution.cpp trace.cpp timeseries.cpp samples.cpp warmup.cpp durability.cpp wal.cpp cache.cpp test.cpp -o run -std=c++17 -g -pthread
@@ -0,0 +1,107 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __DISTRIBUTION__CPP__
+#define __DISTRIBUTION__CPP__
+
+
+#include "distribution.h"
+
+#include <cmath> // std::pow()
+#include <numeric> // std::gcd()
+#include <algorithm> // std::min(), std::max()
+#include <stdexcept> // runtime_error
+#include <string> // std::to_string()
+
+
+// Number of leading zeta terms summed exactly, the tail is approximated by an integral
+constexpr ui64 ExactZetaTerms = 1 << 20;
+
+
+// ~ Returns sum_{i = 1}^{n} i^-theta
+static double Zeta(ui64 n, double theta) {
+    ui64 exact = std::min(n, ExactZetaTerms);
+    double sum = 0;
+    for (ui64 i = 1; i <= exact; i++)
+        sum += std::pow(i, -theta);
+    // Midpoint rule: the terms of (exact, n] approximate the integral over [exact + 0.5, n + 0.5].
+    if (n > exact)
+        sum += (std::pow(n + 0.5, 1 - theta) - std::pow(exact + 0.5, 1 - theta)) / (1 - theta);
+    return sum;
+}
+
+
+TZipfianSampler::TZipfianSampler(ui64 n, double theta)
+    : N(std::max<ui64>(n, 1))
+    , Theta(theta) {
+    if (!(theta > 0 && theta < 1))
+        throw std::runtime_error("TZipfianSampler() error: theta must lie in (0, 1)");
+    Alpha = 1 / (1 - Theta);
+    ZetaN = Zeta(N, Theta);
+    Eta = (1 - std::pow(2.0 / N, 1 - Theta)) / (1 - Zeta(2, Theta) / ZetaN);
+    Threshold = 1 + std::pow(0.5, Theta);
+}
+
+
+TParetoSampler::TParetoSampler(ui64 n, double shape)
+    : N(std::max<ui64>(n, 1)) {
+    if (!(shape > 1))
+        throw std::runtime_error("TParetoSampler() error: shape must be greater than 1");
+    Exponent = shape / (shape - 1);
+}
+
+
+TArrivalProcess::TArrivalProcess(double rate, EArrival arrival, ui64 seed)
+    : Arrival(arrival)
+    , Random(seed) {
+    if (!(rate > 0))
+        throw std::runtime_error("TArrivalProcess() error: rate must be positive");
+    if (arrival > EArrival::Bursty)
+        throw std::runtime_error("TArrivalProcess() error: arrival process " +
+                                 std::to_string(static_cast<ui64>(arrival)) + " not supported");
+    MeanInterval = 1e9 / rate;
+}
+
+
+TOffsetGenerator::TOffsetGenerator(off_t regionStart, ui64 regionSize, ui64 granule,
+                                   const TDistributionParams& params, ui64 seed)
+    : RegionStart(regionStart)
+    , RegionSize(regionSize)
+    , Granule(std::max<ui64>(granule, 1))
+    , Units(std::max<ui64>(regionSize / Granule, 1))
+    , Distribution(params.Distribution)
+    , Random(seed)
+    // The samplers are only built for their own distribution.
+    , Zipfian(params.Distribution == EDistribution::Zipfian ? Units : 1,
+              params.Distribution == EDistribution::Zipfian ? params.ZipfTheta : 0.5)
+    , Pareto(params.Distribution == EDistribution::Pareto ? Units : 1,
+             params.Distribution == EDistribution::Pareto ? params.ParetoShape : 2)
+    , HotOpsPercent(params.HotOpsPercent) {
+    if (Distribution > EDistribution::Pareto)
+        throw std::runtime_error("TOffsetGenerator() error: distribution " +
+                                 std::to_string(static_cast<ui64>(Distribution)) + " not supported");
+    if (params.HotOpsPercent > 100 || params.HotSpacePercent > 100)
+        throw std::runtime_error("TOffsetGenerator() error: hot set percentages must not exceed 100");
+
+    HotUnits = Units * params.HotSpacePercent / 100;
+    HotUnits = std::clamp<ui64>(HotUnits, 1, std::max<ui64>(Units - 1, 1));
+    if (Units == 1)
+        HotOpsPercent = 100;
+
+    // Fibonacci hashing constant, moved to the nearest value coprime with Units.
+    Multiplier = 0x9e3779b97f4a7c15 % Units;
+    if (Multiplier == 0)
+        Multiplier = 1;
+    while (std::gcd(Multiplier, Units) != 1)
+        Multiplier++;
+}
+
+ui64 TOffsetGenerator::GetSeed() const {
+    return Random.GetSeed();
+}
+
+
+
+
+
+
+#endif
@@ -0,0 +1,206 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __DISTRIBUTION__H__
+#define __DISTRIBUTION__H__
+
+
+#include "globals.h"
+
+#include <sys/types.h> // off_t
+#include <vector>
+#include <cmath> // std::pow(), std::log1p()
+
+
+// ~ Distributions of random file offsets selectable through the "DIST" factor
+enum class EDistribution : ui64 {
+    Uniform = 0,
+    Zipfian = 1,
+    Hotspot = 2,
+    Pareto = 3,
+};
+
+
+// ~ Class storing the access distribution parameters
+struct TDistributionParams {
+    EDistribution Distribution = EDistribution::Uniform;
+    // ~ Skew of the Zipfian distribution, 0 < theta < 1
+    double ZipfTheta = 0.99;
+    // ~ Percentage of operations accessing the hot set and the percentage of the file it covers
+    ui64 HotOpsPercent = 80;
+    ui64 HotSpacePercent = 20;
+    // ~ Shape of the Pareto distribution, shape > 1 (1.16 gives the 80/20 rule)
+    double ParetoShape = 1.16;
+};
+
+
+// ~ Zipfian sampler of ranks in [0, n)
+// Gray et al. "Quickly generating billion-record synthetic databases": the normalization
+// constant is computed once, after that a sample takes constant time.
+class TZipfianSampler {
+public:
+    TZipfianSampler(ui64 n, double theta);
+
+    inline ui64 Sample(TRandom& random) const {
+        double u = random.UniformReal();
+        double uz = u * ZetaN;
+        if (uz < 1)
+            return 0;
+        if (uz < Threshold)
+            return 1;
+        ui64 rank = N * std::pow(Eta * u - Eta + 1, Alpha);
+        return (rank < N ? rank : N - 1);
+    }
+
+private:
+    ui64 N;
+    double Theta;
+    double Alpha;
+    double ZetaN;
+    double Eta;
+    // ~ 1 + 0.5^theta, upper bound of the scaled samples mapped to rank 1
+    double Threshold;
+};
+
+
+// ~ Pareto sampler of ranks in [0, n)
+// Follows the Lorenz curve of the Pareto distribution: the top p of the ranks receive
+// p^(1 - 1 / shape) of the samples (shape > 1), i.e. the 80/20 rule for shape = 1.16.
+class TParetoSampler {
+public:
+    TParetoSampler(ui64 n, double shape);
+
+    inline ui64 Sample(TRandom& random) const {
+        ui64 rank = N * std::pow(random.UniformReal(), Exponent);
+        return (rank < N ? rank : N - 1);
+    }
+
+private:
+    ui64 N;
+    // ~ shape / (shape - 1), inverse of the Lorenz curve exponent
+    double Exponent;
+};
+
+
+// ~ Arrival processes of open-loop load selectable through the "ARRIVAL" factor
+enum class EArrival : ui64 {
+    Constant = 0,
+    Poisson = 1,
+    // ~ Poisson arrivals during on-periods separated by silent off-periods
+    Bursty = 2,
+};
+
+
+// ~ Generator of the intervals between operation arrivals
+// All the processes have the same mean rate.
+class TArrivalProcess {
+public:
+    // ~ rate is the mean number of arrivals per second
+    TArrivalProcess(double rate, EArrival arrival, ui64 seed);
+
+    // ~ Returns the interval to the next arrival (in nanoseconds)
+    inline ui64 NextInterval() {
+        switch (Arrival) {
+        case EArrival::Poisson:
+            return Exponential(MeanInterval);
+        case EArrival::Bursty: {
+            // Arrivals are packed into on-periods, skipping the off-periods they cross.
+            ui64 interval = Exponential(MeanInterval * BurstOnPeriod / (BurstOnPeriod + BurstOffPeriod));
+            ui64 total = interval;
+            Position += interval;
+            while (Position >= BurstOnPeriod) {
+                Position -= BurstOnPeriod;
+                total += BurstOffPeriod;
+            }
+            return total;
+        }
+        default:
+            return MeanInterval;
+        }
+    }
+
+private:
+    inline ui64 Exponential(double mean) {
+        return -mean * std::log1p(-Random.UniformReal());
+    }
+
+private:
+    // ~ Durations of the bursty process periods (in nanoseconds)
+    static constexpr ui64 BurstOnPeriod = 10 * 1000 * 1000;
+    static constexpr ui64 BurstOffPeriod = 40 * 1000 * 1000;
+
+    EArrival Arrival;
+    double MeanInterval;
+    TRandom Random;
+    // ~ Position of the last arrival in the current on-period (in nanoseconds)
+    ui64 Position = 0;
+};
+
+
+// ~ Generator of random file offsets
+// The region is split into units of granule bytes which are sampled by the distribution.
+// The offset of an operation is aligned down to a multiple of its size (relative to the region start),
+// so that the operation lies in the region with its whole span.
+// Zipfian and Pareto ranks are scattered over the region by a fixed permutation,
+// the hot set of the Hotspot distribution is the beginning of the region.
+class TOffsetGenerator {
+public:
+    TOffsetGenerator(off_t regionStart, ui64 regionSize, ui64 granule,
+                     const TDistributionParams& params, ui64 seed);
+
+    // ~ Returns an offset of an operation of size bytes accessing span bytes in total
+    inline off_t Next(ui64 size, ui64 span) {
+        ui64 maxPosition = RegionSize - span;
+        if (Distribution == EDistribution::Uniform)
+            return RegionStart + Random.Uniform(maxPosition / size + 1) * size;
+
+        ui64 position = SampleUnit() * Granule;
+        if (position > maxPosition)
+            position = maxPosition;
+        return RegionStart + position - position % size;
+    }
+
+    ui64 GetSeed() const;
+
+private:
+    inline ui64 SampleUnit() {
+        switch (Distribution) {
+        case EDistribution::Zipfian:
+            return Scatter(Zipfian.Sample(Random));
+        case EDistribution::Pareto:
+            return Scatter(Pareto.Sample(Random));
+        case EDistribution::Hotspot:
+            if (Random.Uniform(100) < HotOpsPercent)
+                return Random.Uniform(HotUnits);
+            return HotUnits + Random.Uniform(Units - HotUnits);
+        default:
+            return Random.Uniform(Units);
+        }
+    }
+
+    // ~ Maps a rank to a unit with a multiplicative permutation of [0, Units)
+    inline ui64 Scatter(ui64 rank) const {
+        return static_cast<ui64>(static_cast<unsigned __int128>(rank) * Multiplier % Units);
+    }
+
+private:
+    off_t RegionStart;
+    ui64 RegionSize;
+    ui64 Granule;
+    ui64 Units;
+    EDistribution Distribution;
+    TRandom Random;
+    TZipfianSampler Zipfian;
+    TParetoSampler Pareto;
+    // ~ Multiplier coprime with Units used by Scatter()
+    ui64 Multiplier = 1;
+    ui64 HotOpsPercent;
+    // ~ Number of units in the hot set, at least 1 and less than Units (if Units > 1)
+    ui64 HotUnits;
+};
+
+
+
+
+
+
+#endif
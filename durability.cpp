@@ -0,0 +1,79 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __DURABILITY__CPP__
+#define __DURABILITY__CPP__
+
+
+#include "durability.h"
+
+#include <fcntl.h> // sync_file_range()
+#include <unistd.h> // fsync(), fdatasync()
+#include <cerrno> // errno
+#include <cstring> // strerror()
+#include <stdexcept> // runtime_error
+#include <string> // std::to_string()
+
+
+TFlusher::TFlusher(int fd, EDurability mode, ui64 every)
+    : Fd(fd)
+    , Mode(mode)
+    , Every(std::max<ui64>(every, 1)) {
+    switch (mode) {
+    case EDurability::None:
+    case EDurability::DSync:
+        Every = 0;
+        break;
+    case EDurability::Fsync:
+    case EDurability::Fdatasync:
+        break;
+    case EDurability::SyncFileRange:
+        #if defined (__linux__)
+        break;
+        #else
+        throw std::runtime_error("TFlusher() error: sync_file_range() is only supported on Linux");
+        #endif
+    default:
+        throw std::runtime_error("TFlusher() error: durability mode " +
+                                 std::to_string(static_cast<ui32>(mode)) + " not supported");
+    }
+}
+
+void TFlusher::SetLatencies(THistogram* latencies) {
+    Latencies = latencies;
+}
+
+ui64 TFlusher::Flush() {
+    auto start = Nhrc::now();
+    int result = 0;
+    switch (Mode) {
+    case EDurability::Fsync:
+        result = fsync(Fd);
+        break;
+    case EDurability::Fdatasync:
+        result = fdatasync(Fd);
+        break;
+    #if defined (__linux__)
+    case EDurability::SyncFileRange:
+        result = sync_file_range(Fd, RangeStart, RangeEnd - RangeStart,
+                                 SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        break;
+    #endif
+    default:
+        break;
+    }
+    if (result == -1)
+        throw std::runtime_error(std::string("TFlusher::Flush() error: ") + strerror(errno));
+    Pending = 0;
+
+    ui64 latency = Duration(start, Nhrc::now());
+    if (Latencies)
+        Latencies->Add(latency);
+    return latency;
+}
+
+
+
+
+
+
+#endif
@@ -0,0 +1,75 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __DURABILITY__H__
+#define __DURABILITY__H__
+
+
+#include "globals.h"
+#include "histogram.h"
+
+#include <sys/types.h> // off_t
+#include <algorithm> // std::min(), std::max()
+
+
+// ~ Ways of making the written data durable selectable through the "SYNC" factor
+enum class EDurability : ui32 {
+    // ~ Writes stay in the page cache
+    None = 0,
+    // ~ fsync() once every SYNCN writes
+    Fsync = 1,
+    // ~ fdatasync() once every SYNCN writes
+    Fdatasync = 2,
+    // ~ The file is opened with O_DSYNC, every write is durable on completion
+    DSync = 3,
+    // ~ sync_file_range() of the range covered by the last SYNCN writes (data only, Linux)
+    SyncFileRange = 4,
+};
+
+
+// ~ Class flushing the writes of a single worker thread
+// The writes are counted and the file is flushed once every `every` of them. The caller ends its batch
+// at the write making a flush due (see GetWritesUntilFlush()), so that each flush covers the writes
+// since the previous one. Flush latencies are recorded in the histogram set, separately from the
+// latencies of the data operations.
+class TFlusher {
+public:
+    TFlusher(int fd, EDurability mode, ui64 every);
+
+    // ~ Returns the number of writes the next flush is due after, 0 if the mode does not flush
+    inline ui64 GetWritesUntilFlush() const {
+        return (Every == 0 ? 0 : Every - Pending);
+    }
+
+    // ~ Registers a completed write of [offset, offset + size), returns true if a flush is due
+    inline bool Write(off_t offset, ui64 size) {
+        if (Every == 0)
+            return false;
+        RangeStart = (Pending == 0 ? offset : std::min<off_t>(RangeStart, offset));
+        RangeEnd = (Pending == 0 ? offset + size : std::max<off_t>(RangeEnd, offset + size));
+        return ++Pending >= Every;
+    }
+
+    // ~ Flushes the writes registered since the last flush, returns its latency (in microseconds)
+    ui64 Flush();
+
+    // ~ Sets the histogram receiving flush latencies (in microseconds), disabled if nullptr is passed
+    void SetLatencies(THistogram* latencies);
+
+private:
+    int Fd;
+    EDurability Mode;
+    // ~ Number of writes per flush (0 if the mode does not flush)
+    ui64 Every;
+    // ~ Writes since the last flush and the range they cover
+    ui64 Pending = 0;
+    off_t RangeStart = 0;
+    off_t RangeEnd = 0;
+    THistogram* Latencies = nullptr;
+};
+
+
+
+
+
+
+#endif
@@ -8,7 +8,8 @@
 
 #include <stdexcept> // std::runtime_error()
 #include <random> // std::random_device, std::mt19937
-#include <algorithm> // std::shuffle()
+#include <algorithm> // std::shuffle(), std::max(), std::sort()
+#include <cmath> // std::sqrt()
 
 //!!
 #include <iostream>
@@ -28,6 +29,33 @@ void AddVectors(std::vector<ui64>& result, const std::vector<ui64>& toAdd) {
 }
 
 
+std::string DescribeExperiment(const TPattern& pattern, const TEnvironmentParams& environment,
+                               ui64 testDuration, ui32 batchSize) {
+    std::string sizes;
+    for (auto [size, percent] : pattern.RequestSizes)
+        sizes += (sizes.empty() ? "" : ",") + std::to_string(size) + ":" + std::to_string(percent);
+    return "consecutive_percent=" + std::to_string(pattern.ConsecutivePercent) + "\n"
+           + "read_percent=" + std::to_string(pattern.ReadPercent) + "\n"
+           + "request_sizes=" + sizes + "\n"
+           + "trace=" + pattern.TracePath + "\n"
+           + "filepath=" + environment.Filepath + "\n"
+           + "filesize=" + std::to_string(environment.Filesize) + "\n"
+           + "fill_mode=" + std::to_string(static_cast<ui32>(environment.FillMode)) + "\n"
+           + "seed=" + std::to_string(environment.Seed) + "\n"
+           + "timer=" + std::to_string(static_cast<ui32>(environment.Timer)) + "\n"
+           + "duration_us=" + std::to_string(testDuration) + "\n"
+           + "batch_size=" + std::to_string(batchSize) + "\n";
+}
+
+
+std::string DescribeLevels(const TFactorLevels& levels) {
+    std::string result;
+    for (const auto& factor : FactorNames)
+        result += factor + "=" + std::to_string(levels.GetLevel(factor)) + "\n";
+    return result;
+}
+
+
 TExperimenter::TExperimenter(TPattern pattern,
                              std::vector<TFactorLevels>&& factorLevels,
                              const TWarmupParams& warmup,
@@ -35,7 +63,8 @@ TExperimenter::TExperimenter(TPattern pattern,
                              ui64 testDuration,
                              ui32 batchSize,
                              ui32 replays,
-                             const std::vector<std::string>& varyingFactors)
+                             const std::vector<std::string>& varyingFactors,
+                             const TSearchParams& search)
                              : Pattern(pattern)
                              , FactorLevels(factorLevels)
                              , Warmup(warmup)
@@ -44,18 +73,61 @@ TExperimenter::TExperimenter(TPattern pattern,
                              , BatchSize(batchSize)
                              , Replays(replays)
                              , VaryingFactors(varyingFactors)
-                             , APIFactories(factorLevels.size()) {}
+                             , SearchParams(search) {
+    TClock::SetSource(Environment.Timer);
+    std::cerr << "Timer " << static_cast<ui32>(Environment.Timer) << " read cost: " << TClock::Cost() << " ns\n";
+    for (const auto& levels : FactorLevels)
+        APIFactories.emplace_back(CreateAPIFactory(static_cast<EEngine>(levels.Engine)));
+    if (!Environment.TimeSeriesPath.empty())
+        TimeSeries = std::make_shared<TTimeSeriesWriter>(Environment.TimeSeriesPath, Environment.TimeSeriesInterval);
+    if (!Environment.SamplesPath.empty())
+        Samples = std::make_shared<TSampleWriter>(Environment.SamplesPath,
+                                                  DescribeExperiment(Pattern, Environment, TestDuration, BatchSize));
+}
 
 
-std::vector<std::pair<ui64, ui64>> TExperimenter::Experiment() const {
+std::vector<TTestResult> TExperimenter::Experiment() const {
     std::cerr << "\nStarting experiment\n";
     std::vector<std::vector<ui64>> testResults(FactorLevels.size(), std::vector<ui64>());
+    std::vector<THistogram> opLatencies(FactorLevels.size());
+    std::vector<ld> fairness(FactorLevels.size(), 0);
+    std::vector<std::pair<ui64, ui64>> pageFaults(FactorLevels.size());
+    std::vector<ui64> wouldBlock(FactorLevels.size(), 0);
+    std::vector<THistogram> flushLatencies(FactorLevels.size());
+    std::vector<ld> resident(FactorLevels.size(), 0);
+    // ~ Runs of each test and the sum of the squared half-widths of their throughput intervals
+    std::vector<ui32> runs(FactorLevels.size(), 0);
+    std::vector<ld> squaredHalfWidths(FactorLevels.size(), 0);
     std::vector<ui32> order = GenerateOrder();
     std::vector<TBenchmark> benchmarks = CreateBenchmarks();
 
     for (ui32 i = 0; i < order.size(); i++) {
+        // A replay takes as many runs as there are tests
+        if (Environment.InvalidateFixtures && i > 0 && i % FactorLevels.size() == 0)
+            Fixtures->Invalidate();
+        if (TimeSeries)
+            TimeSeries->StartRun(order[i]);
+        if (Samples)
+            Samples->StartRun(order[i], DescribeLevels(FactorLevels[order[i]]));
         auto result = benchmarks[order[i]].Benchmark();
-        AddVectors(testResults[order[i]], ConvertToThroughput(result, order[i]));
+        // Runs stopped by the precision differ in length, so the replays are averaged over the common length.
+        auto throughputs = AggregateThroughput(result);
+        auto& sum = testResults[order[i]];
+        if (runs[order[i]]++ == 0) {
+            sum = throughputs;
+        } else {
+            sum.resize(std::min(sum.size(), throughputs.size()));
+            for (ui64 j = 0; j < sum.size(); j++)
+                sum[j] += throughputs[j];
+        }
+        squaredHalfWidths[order[i]] += result.ThroughputInterval.second * result.ThroughputInterval.second;
+        opLatencies[order[i]].Merge(result.OpLatencies);
+        fairness[order[i]] += Fairness(result);
+        pageFaults[order[i]].first += result.MinorFaults;
+        pageFaults[order[i]].second += result.MajorFaults;
+        wouldBlock[order[i]] += result.WouldBlock;
+        flushLatencies[order[i]].Merge(result.FlushLatencies);
+        resident[order[i]] += result.Resident;
         std::cerr << "Finished test: " << (i + 1) << "/" << order.size() << "\n";
     }
 
@@ -63,9 +135,34 @@ std::vector<std::pair<ui64, ui64>> TExperimenter::Experiment() const {
         for (auto& value : result)
             value /= Replays;
 
-    std::vector<std::pair<ui64, ui64>> resultStatistics(testResults.size());
-    for (ui32 i = 0; i < testResults.size(); i++)
-        resultStatistics[i] = Statistics(testResults[i]);
+    std::vector<TTestResult> resultStatistics(testResults.size());
+    for (ui32 i = 0; i < testResults.size(); i++) {
+        resultStatistics[i].Throughput = Statistics(testResults[i]);
+        // The mean of independent replays has the root of the sum of their squared half-widths over their number.
+        ld halfWidth = std::sqrt(squaredHalfWidths[i]) / Replays;
+        resultStatistics[i].ThroughputCI = (std::isfinite(halfWidth) ? halfWidth : 0);
+        resultStatistics[i].OpLatency = opLatencies[i].Statistics();
+        resultStatistics[i].OpLatencyP50 = opLatencies[i].Percentile(50);
+        resultStatistics[i].OpLatencyP90 = opLatencies[i].Percentile(90);
+        resultStatistics[i].OpLatencyP99 = opLatencies[i].Percentile(99);
+        resultStatistics[i].OpLatencyP999 = opLatencies[i].Percentile(99.9);
+        resultStatistics[i].OpLatencyMax = opLatencies[i].GetMax();
+        resultStatistics[i].Fairness = fairness[i] / Replays;
+        resultStatistics[i].MinorFaults = pageFaults[i].first / Replays;
+        resultStatistics[i].MajorFaults = pageFaults[i].second / Replays;
+        resultStatistics[i].Resident = resident[i] / Replays;
+        resultStatistics[i].WouldBlock = wouldBlock[i] / Replays;
+        resultStatistics[i].Flushes = flushLatencies[i].GetCount() / Replays;
+        resultStatistics[i].FlushLatency = flushLatencies[i].Statistics();
+        resultStatistics[i].FlushLatencyP99 = flushLatencies[i].Percentile(99);
+        resultStatistics[i].FlushLatencyMax = flushLatencies[i].GetMax();
+    }
+
+    if (Environment.Calibrate) {
+        std::cerr << "\nCalibrating harness overhead\n";
+        for (ui32 i = 0; i < FactorLevels.size(); i++)
+            resultStatistics[i].HarnessOverhead = HarnessOverhead(i);
+    }
 
     return resultStatistics;
 }
@@ -86,6 +183,178 @@ const std::vector<std::string>& TExperimenter::GetVaryingFactors() const {
 }
 
 
+const TSearchParams& TExperimenter::GetSearchParams() const {
+    return SearchParams;
+}
+
+
+TSearchResult TExperimenter::Search() const {
+    std::cerr << "\nStarting search over " << FactorLevels.size() << " combinations\n";
+    TSearchState state;
+
+    // Successive halving: a random sample of the combinations gets one run each,
+    // the better half gets one more run, and so on until a single combination is left.
+    ui32 sampleSize = std::min<ui64>(FactorLevels.size(),
+                                     SearchParams.Budget > 0 ? std::max<ui32>(4, SearchParams.Budget / 4) : 16);
+    std::vector<ui32> candidates(FactorLevels.size());
+    for (ui32 i = 0; i < candidates.size(); i++)
+        candidates[i] = i;
+    TRandom random(Environment.Seed != 0 ? Environment.Seed
+                                         : (static_cast<ui64>(std::random_device()()) << 32) | std::random_device()());
+    for (ui32 i = 0; i < sampleSize; i++)
+        std::swap(candidates[i], candidates[i + random.Uniform(candidates.size() - i)]);
+    candidates.resize(sampleSize);
+
+    for (ui32 rung = 1; candidates.size() > 1 && BudgetLeft(state); rung++) {
+        for (ui32 test : candidates)
+            Measure(state, test, rung, "halving");
+        std::stable_sort(candidates.begin(), candidates.end(), [&](ui32 lhs, ui32 rhs) {
+            return Compare(state, lhs, rhs, false) > 0;
+        });
+        candidates.resize((candidates.size() + 1) / 2);
+    }
+
+    // Hill climbing: move to the first neighbour which is significantly better.
+    ui32 current = candidates[0];
+    bool moved = true;
+    while (moved && BudgetLeft(state)) {
+        moved = false;
+        for (ui32 neighbour : Neighbours(current)) {
+            if (!BudgetLeft(state))
+                break;
+            if (Improves(state, neighbour, current)) {
+                current = neighbour;
+                moved = true;
+                break;
+            }
+        }
+    }
+    Measure(state, current, 1, "climbing");
+
+    TSearchResult& result = state.Result;
+    result.Best = current;
+    result.Throughput = Statistics(state.Throughputs[current]);
+    result.OpLatencyP99 = Statistics(state.OpLatencyP99s[current]);
+    result.Runs = state.Throughputs[current].size();
+    return result;
+}
+
+
+void TExperimenter::Measure(TSearchState& state, ui32 test, ui32 runs, const std::string& stage) const {
+    auto it = state.Benchmarks.find(test);
+    if (it == state.Benchmarks.end())
+        it = state.Benchmarks.emplace(test, TBenchmark(Pattern, FactorLevels[test], Warmup, Environment,
+                                                       TestDuration, BatchSize, APIFactories[test].get(),
+                                                       Fixtures, TimeSeries, Samples)).first;
+    auto& throughputs = state.Throughputs[test];
+    auto& p99s = state.OpLatencyP99s[test];
+    // The combination the search ends at is measured even if the budget is exhausted.
+    while (throughputs.size() < runs && (BudgetLeft(state) || throughputs.empty())) {
+        if (TimeSeries)
+            TimeSeries->StartRun(test);
+        if (Samples)
+            Samples->StartRun(test, DescribeLevels(FactorLevels[test]));
+        auto result = it->second.Benchmark();
+        TSearchStep step;
+        step.Stage = stage;
+        step.Test = test;
+        step.Throughput = Statistics(AggregateThroughput(result)).first;
+        step.OpLatencyP99 = result.OpLatencies.Percentile(99);
+        throughputs.push_back(step.Throughput);
+        p99s.push_back(step.OpLatencyP99);
+        state.Result.Trajectory.push_back(step);
+        std::cerr << "Search run " << state.Result.Trajectory.size() << " (" << stage << "): test " << test
+                  << ", " << step.Throughput << " B/s, p99 " << step.OpLatencyP99 << " us\n";
+    }
+}
+
+
+bool TExperimenter::BudgetLeft(const TSearchState& state) const {
+    return SearchParams.Budget == 0 || state.Result.Trajectory.size() < SearchParams.Budget;
+}
+
+
+i32 TExperimenter::Compare(const TSearchState& state, ui32 lhs, ui32 rhs, bool significance) const {
+    // Welch's t statistic of the difference of two means, |t| > 2 is significant at about 95%.
+    auto compareMeans = [&](const std::vector<ui64>& lhsSample, const std::vector<ui64>& rhsSample) -> i32 {
+        auto [lhsMean, lhsStd] = Statistics(lhsSample);
+        auto [rhsMean, rhsStd] = Statistics(rhsSample);
+        ld difference = (ld)lhsMean - rhsMean;
+        if (!significance || difference == 0)
+            return (difference > 0) - (difference < 0);
+        if (lhsSample.size() < 2 || rhsSample.size() < 2)
+            return 0;
+        ld error = std::sqrt((ld)lhsStd * lhsStd / lhsSample.size() + (ld)rhsStd * rhsStd / rhsSample.size());
+        if (error == 0 || std::abs(difference / error) > 2)
+            return (difference > 0 ? 1 : -1);
+        return 0;
+    };
+
+    const auto& lhsThroughputs = state.Throughputs.at(lhs);
+    const auto& rhsThroughputs = state.Throughputs.at(rhs);
+    if (SearchParams.Mode == ESearchMode::MaxThroughput)
+        return compareMeans(lhsThroughputs, rhsThroughputs);
+
+    // Feasible combinations beat the infeasible ones, which are compared by throughput.
+    bool lhsFeasible = Statistics(lhsThroughputs).first >= SearchParams.ThroughputFloor;
+    bool rhsFeasible = Statistics(rhsThroughputs).first >= SearchParams.ThroughputFloor;
+    if (lhsFeasible != rhsFeasible)
+        return (lhsFeasible ? 1 : -1);
+    if (!lhsFeasible)
+        return compareMeans(lhsThroughputs, rhsThroughputs);
+    return -compareMeans(state.OpLatencyP99s.at(lhs), state.OpLatencyP99s.at(rhs));
+}
+
+
+bool TExperimenter::Improves(TSearchState& state, ui32 candidate, ui32 current) const {
+    // Comparisons need at least two runs of each combination to estimate the variance.
+    const ui32 minRuns = std::max<ui32>(Replays, 2);
+    for (ui32 runs = minRuns; ; runs++) {
+        Measure(state, candidate, runs, "climbing");
+        Measure(state, current, runs, "climbing");
+        i32 verdict = Compare(state, candidate, current, true);
+        if (verdict != 0)
+            return verdict > 0;
+        // Undecided comparisons get more runs up to a limit, then the current combination is kept.
+        if (runs >= 4 * minRuns || !BudgetLeft(state))
+            return false;
+    }
+}
+
+
+std::vector<ui32> TExperimenter::Neighbours(ui32 test) const {
+    // ~ Sorted levels of each varying factor
+    std::vector<std::vector<ui64>> levels(VaryingFactors.size());
+    for (ui32 f = 0; f < VaryingFactors.size(); f++) {
+        for (const auto& combination : FactorLevels)
+            levels[f].push_back(combination.GetLevel(VaryingFactors[f]));
+        std::sort(levels[f].begin(), levels[f].end());
+        levels[f].erase(std::unique(levels[f].begin(), levels[f].end()), levels[f].end());
+    }
+    auto position = [&](ui32 f, ui32 combination) {
+        ui64 level = FactorLevels[combination].GetLevel(VaryingFactors[f]);
+        return std::lower_bound(levels[f].begin(), levels[f].end(), level) - levels[f].begin();
+    };
+
+    std::vector<ui32> neighbours;
+    for (ui32 other = 0; other < FactorLevels.size(); other++) {
+        ui32 differing = 0;
+        bool adjacent = true;
+        for (ui32 f = 0; f < VaryingFactors.size(); f++) {
+            auto lhs = position(f, test);
+            auto rhs = position(f, other);
+            if (lhs == rhs)
+                continue;
+            differing++;
+            adjacent &= (IsCategorical(VaryingFactors[f]) || lhs + 1 == rhs || rhs + 1 == lhs);
+        }
+        if (differing == 1 && adjacent)
+            neighbours.push_back(other);
+    }
+    return neighbours;
+}
+
+
 std::vector<ui32> TExperimenter::GenerateOrder() const {
     ui64 tests = FactorLevels.size();
     std::vector<ui32> order(tests * Replays);
@@ -102,19 +371,82 @@ std::vector<ui32> TExperimenter::GenerateOrder() const {
 std::vector<TBenchmark> TExperimenter::CreateBenchmarks() const {
     std::vector<TBenchmark> benchmarks;
     for (ui32 test = 0; test < FactorLevels.size(); test++) {
-        TBenchmark benchmark(Pattern, FactorLevels[test], Warmup, Environment, TestDuration, BatchSize, &APIFactories[test]);
+        TBenchmark benchmark(Pattern, FactorLevels[test], Warmup, Environment, TestDuration, BatchSize,
+                             APIFactories[test].get(), Fixtures, TimeSeries, Samples);
         benchmarks.push_back(benchmark);
     }
     return benchmarks;
 }
 
 
-std::vector<ui64> TExperimenter::ConvertToThroughput(const std::vector<ui64>& latencies, ui32 test) const {
+std::vector<ui64> TExperimenter::AggregateThroughput(const TBenchmarkResult& result) const {
+    // Workers run concurrently, so i-th batches of all the workers are summed up.
+    // The sample is cut to the shortest worker.
+    std::vector<ui64> throughputs;
+    for (const auto& worker : result.Workers) {
+        auto workerThroughputs = ConvertToThroughput(worker);
+        if (throughputs.size() > workerThroughputs.size())
+            throughputs.resize(workerThroughputs.size());
+        AddVectors(throughputs, workerThroughputs);
+    }
+    return throughputs;
+}
+
+
+ui64 TExperimenter::HarnessOverhead(ui32 test) const {
+    // The loop is the one of the test, except for the engine and the arrival process:
+    // waiting for the intended starts is not overhead. Nothing reaches the file either, so the
+    // cache state, readahead hints and flushes of the test are disabled. WAL tests are calibrated
+    // with the plain loop, as their commits are fdatasync() calls on the log, i.e. I/O.
+    TFactorLevels levels = FactorLevels[test];
+    levels.Engine = static_cast<ui64>(EEngine::Null);
+    levels.Rate = 0;
+    levels.Wal = static_cast<ui64>(EWalMode::Off);
+    levels.CacheState = static_cast<ui64>(ECacheState::AsIs);
+    levels.FileAdvice = static_cast<ui64>(EFileAdvice::Normal);
+    levels.Readahead = 0;
+    levels.BlockReadahead = 0;
+    levels.Sync = static_cast<ui64>(EDurability::None);
+    TEnvironmentParams environment = Environment;
+    environment.PreparationScript = "";
+    auto factory = CreateAPIFactory(EEngine::Null);
+    TBenchmark benchmark(Pattern, levels, Warmup, environment, std::min<ui64>(TestDuration, 1_s), BatchSize,
+                         factory.get(), Fixtures);
+    auto result = benchmark.Benchmark();
+
+    // Only the time inside the timed batches counts, the generation of the next batch
+    // between them does not reach the latencies.
+    ui64 busyTime = 0;
+    for (const auto& worker : result.Workers)
+        busyTime += worker.BusyTime;
+    ui64 ops = result.OpLatencies.GetCount();
+    ui64 overhead = (ops > 0 ? busyTime / ops : 0);
+    std::cerr << "Harness overhead of test " << test << ": " << overhead << " ns per operation\n";
+    return overhead;
+}
+
+
+ld TExperimenter::Fairness(const TBenchmarkResult& result) const {
+    // Jain's fairness index of the workers throughputs: (sum x)^2 / (n * sum x^2).
+    ld sum = 0;
+    ld squaresSum = 0;
+    for (const auto& worker : result.Workers) {
+        ld bytes = 0;
+        for (ui64 value : worker.Bytes)
+            bytes += value;
+        ld throughput = bytes / std::max<ui64>(worker.Duration, 1);
+        sum += throughput;
+        squaresSum += throughput * throughput;
+    }
+    return (squaresSum > 0 ? sum * sum / (result.Workers.size() * squaresSum) : 1);
+}
+
+
+std::vector<ui64> TExperimenter::ConvertToThroughput(const TWorkerResult& worker) const {
+    const auto& latencies = worker.Latencies;
     std::vector<ui64> throughputs(latencies.size());
-    ui64 rs = FactorLevels[test].RequestSize;
-    ui64 qd = FactorLevels[test].QueueDepth;
     for (ui64 i = 0; i < latencies.size(); i++)
-        throughputs[i] = BatchSize * rs * qd * 1_s / latencies[i];
+        throughputs[i] = worker.Bytes[i] * 1_s / std::max<ui64>(latencies[i], 1);
     return throughputs;
 }
 
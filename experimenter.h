@@ -6,9 +6,101 @@
 
 #include "benchmark.h"
 
+#include <memory> // std::shared_ptr
+#include <map>
+
 
 void AddVectors(std::vector<ui64>& result, const std::vector<ui64>& toAdd);
 
+// ~ Describes the experiment parameters as "name=value" lines (stored in the raw samples file)
+std::string DescribeExperiment(const TPattern& pattern, const TEnvironmentParams& environment,
+                               ui64 testDuration, ui32 batchSize);
+
+// ~ Describes the factor levels as "NAME=value" lines
+std::string DescribeLevels(const TFactorLevels& levels);
+
+
+// ~ Class storing the result of a single point in the factor space
+struct TTestResult {
+    // ~ Throughput (mean, std) in bytes per second
+    std::pair<ui64, ui64> Throughput;
+    // ~ Half-width of the 95% confidence interval of the mean throughput (0 if unknown)
+    // Combined from the batch means intervals the runs reached (see TBenchmarkResult::ThroughputInterval).
+    ui64 ThroughputCI = 0;
+    // ~ Latency of a single operation (mean, std) in microseconds
+    std::pair<ui64, ui64> OpLatency;
+    // ~ Percentiles of single operation latency in microseconds
+    ui64 OpLatencyP50 = 0;
+    ui64 OpLatencyP90 = 0;
+    ui64 OpLatencyP99 = 0;
+    ui64 OpLatencyP999 = 0;
+    ui64 OpLatencyMax = 0;
+    // ~ Jain's fairness index of the worker threads throughputs
+    // 1 means equal throughputs, 1 / threads means a single thread getting everything.
+    ld Fairness = 1;
+    // ~ Page faults taken during a single measurement (averaged over replays)
+    ui64 MinorFaults = 0;
+    ui64 MajorFaults = 0;
+    // ~ Fraction of the file resident in the page cache when the measurement started (averaged over replays)
+    ld Resident = 0;
+    // ~ Operations which would have blocked under RWF_NOWAIT (averaged over replays)
+    ui64 WouldBlock = 0;
+    // ~ Flushes made during a single measurement (averaged over replays)
+    ui64 Flushes = 0;
+    // ~ Latency of a flush (mean, std), its p99 and maximum in microseconds
+    std::pair<ui64, ui64> FlushLatency;
+    ui64 FlushLatencyP99 = 0;
+    ui64 FlushLatencyMax = 0;
+    // ~ Time the harness spends on a single operation of the null engine (in nanoseconds, 0 if not calibrated)
+    ui64 HarnessOverhead = 0;
+};
+
+
+// ~ Modes of an experiment
+enum class ESearchMode : ui32 {
+    // ~ Every combination of the factor levels is measured
+    Full = 0,
+    // ~ The combination with the highest throughput is searched for
+    MaxThroughput = 1,
+    // ~ The combination with the lowest p99 latency among the ones reaching the throughput floor is searched for
+    MinP99 = 2,
+};
+
+
+// ~ Class storing the parameters of the factor space search
+struct TSearchParams {
+    ESearchMode Mode = ESearchMode::Full;
+    // ~ Minimum throughput of the MinP99 mode (in bytes per second)
+    ui64 ThroughputFloor = 0;
+    // ~ Maximum number of benchmark runs (0 = unlimited)
+    ui32 Budget = 0;
+};
+
+
+// ~ Single benchmark run of the search
+struct TSearchStep {
+    // ~ Stage of the search: "halving" or "climbing"
+    std::string Stage;
+    // ~ Index of the combination of the factor levels
+    ui32 Test = 0;
+    // ~ Throughput (in bytes per second) and p99 latency of a single operation (in microseconds) of the run
+    ui64 Throughput = 0;
+    ui64 OpLatencyP99 = 0;
+};
+
+
+// ~ Class storing the result of the factor space search
+struct TSearchResult {
+    // ~ Index of the best combination found
+    ui32 Best = 0;
+    // ~ Throughput and p99 latency (mean, std) over the runs of the best combination
+    std::pair<ui64, ui64> Throughput;
+    std::pair<ui64, ui64> OpLatencyP99;
+    ui32 Runs = 0;
+    // ~ All the runs in the order they were performed
+    std::vector<TSearchStep> Trajectory;
+};
+
 
 // ~ Class for conducting multifactor experiments
 // Intended for benchmarking multiple points in the factor space multiple times
@@ -21,11 +113,20 @@ public:
                   ui64 testDuration,
                   ui32 batchSize,
                   ui32 replays,
-                  const std::vector<std::string>& varyingFactors);
+                  const std::vector<std::string>& varyingFactors,
+                  const TSearchParams& search = TSearchParams());
 
     // Performs an experiment and returns result in the same order
     // in which factorLevels were provided.
-    std::vector<std::pair<ui64, ui64>> Experiment() const;
+    std::vector<TTestResult> Experiment() const;
+
+    // ~ Searches the factor space for the best combination of levels
+    // Successive halving over a random sample of the combinations picks a starting point,
+    // then hill climbing moves to neighbouring combinations (one varying factor changed
+    // by one level) while they are significantly better. Only the points visited are measured.
+    TSearchResult Search() const;
+
+    const TSearchParams& GetSearchParams() const;
 
     TPattern GetPattern() const;
 
@@ -38,7 +139,44 @@ private:
 
     std::vector<TBenchmark> CreateBenchmarks() const;
 
-    std::vector<ui64> ConvertToThroughput(const std::vector<ui64>& latencies, ui32 test) const;
+    std::vector<ui64> ConvertToThroughput(const TWorkerResult& worker) const;
+
+    // ~ Converts the batch latencies of all the workers into a sample of aggregate throughput
+    std::vector<ui64> AggregateThroughput(const TBenchmarkResult& result) const;
+
+    ld Fairness(const TBenchmarkResult& result) const;
+
+    // ~ Runs the benchmark loop of the test against the null engine
+    // Returns the time spent per operation (in nanoseconds), i.e. the part of the latencies
+    // of the test taken by the timer, the dispatch and the bookkeeping.
+    ui64 HarnessOverhead(ui32 test) const;
+
+    // ~ Measurements of the search, benchmarks are created for the visited combinations only
+    struct TSearchState {
+        std::map<ui32, TBenchmark> Benchmarks;
+        std::map<ui32, std::vector<ui64>> Throughputs;
+        std::map<ui32, std::vector<ui64>> OpLatencyP99s;
+        TSearchResult Result;
+    };
+
+    // ~ Runs the benchmark of the combination until it has at least runs measurements
+    // Stops early when the budget is exhausted.
+    void Measure(TSearchState& state, ui32 test, ui32 runs, const std::string& stage) const;
+
+    bool BudgetLeft(const TSearchState& state) const;
+
+    // ~ Compares the objective of two measured combinations
+    // Returns 1 if lhs is better, -1 if it is worse and 0 if the difference is not significant.
+    // Only the means are compared if significance is not required.
+    i32 Compare(const TSearchState& state, ui32 lhs, ui32 rhs, bool significance) const;
+
+    // ~ Measures the candidate and the current combinations until the difference is significant
+    // or the runs limit is reached. Returns true if the candidate is significantly better.
+    bool Improves(TSearchState& state, ui32 candidate, ui32 current) const;
+
+    // ~ Returns the combinations differing from the given one in a single varying factor
+    // Numeric levels are adjacent in the sorted order, all the levels of categorical factors are neighbours.
+    std::vector<ui32> Neighbours(ui32 test) const;
 
 private:
     TPattern Pattern;
@@ -49,7 +187,15 @@ private:
     ui32 BatchSize;
     ui32 Replays;
     std::vector<std::string> VaryingFactors;
-    mutable std::vector<TAPIFactory<TPosixAPI>> APIFactories;
+    TSearchParams SearchParams;
+    // ~ Factories of the engines selected for each test
+    std::vector<std::shared_ptr<IAPIFactory>> APIFactories;
+    // ~ Test files prepared once and shared by all the tests
+    std::shared_ptr<TFixtureCache> Fixtures = std::make_shared<TFixtureCache>();
+    // ~ Writer of the time series of all the runs (nullptr if disabled)
+    std::shared_ptr<TTimeSeriesWriter> TimeSeries;
+    // ~ Writer of the raw samples of all the runs (nullptr if disabled)
+    std::shared_ptr<TSampleWriter> Samples;
 };
 
 
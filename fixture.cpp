@@ -0,0 +1,198 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __FIXTURE__CPP__
+#define __FIXTURE__CPP__
+
+
+#include "fixture.h"
+#include "arena.h"
+
+#include <sys/stat.h> // stat(), open flags
+#include <sys/ioctl.h> // ioctl()
+#include <fcntl.h> // open(), fallocate()
+#include <unistd.h> // pwrite(), ftruncate(), fdatasync(), unlink()
+#include <cerrno> // errno
+#include <cstring> // strerror()
+#include <ctime> // time()
+#include <cstdio> // rename()
+#include <string> // std::to_string()
+#include <stdexcept> // runtime_error
+#include <thread> // std::thread
+#include <exception> // std::exception_ptr
+#include <vector>
+#include <algorithm> // std::min(), std::max()
+
+#if defined (__linux__)
+#include <linux/fs.h> // FICLONE
+#endif
+
+
+// Size of a single filling write
+constexpr ui64 FillChunkSize = 1024 * 1024;
+// Maximum number of threads filling a file
+constexpr ui32 MaxFillThreads = 8;
+
+
+// ~ Writes pseudo-random data into [0, filesize) of fd with multiple threads
+static void FillFile(int fd, ui64 filesize) {
+    if (filesize == 0)
+        return;
+    ui64 chunks = (filesize + FillChunkSize - 1) / FillChunkSize;
+    ui32 threads = std::min<ui64>(std::clamp<ui32>(std::thread::hardware_concurrency(), 1, MaxFillThreads), chunks);
+    ui64 chunksPerThread = (chunks + threads - 1) / threads;
+
+    std::vector<std::thread> writers;
+    std::vector<std::exception_ptr> errors(threads);
+    for (ui32 i = 0; i < threads; i++) {
+        writers.emplace_back([&, i]() {
+            try {
+                TBufferArena arena;
+                arena.Reserve(FillChunkSize, false);
+                ui64* data = static_cast<ui64*>(arena.Allocate(FillChunkSize, sysconf(_SC_PAGESIZE)));
+                // xorshift64, so that the blocks are not trivially compressible or deduplicated
+                ui64 state = (time(nullptr) << 8) + i + 1;
+                for (ui64 j = 0; j < FillChunkSize / sizeof(ui64); j++) {
+                    state ^= state << 13;
+                    state ^= state >> 7;
+                    state ^= state << 17;
+                    data[j] = state;
+                }
+
+                ui64 first = i * chunksPerThread;
+                ui64 last = std::min(chunks, first + chunksPerThread);
+                for (ui64 chunk = first; chunk < last; chunk++) {
+                    off_t offset = chunk * FillChunkSize;
+                    size_t count = std::min<ui64>(FillChunkSize, filesize - offset);
+                    data[0] = chunk;
+                    if (pwrite(fd, data, count, offset) != (ssize_t)count)
+                        throw std::runtime_error(std::string("FillFile() pwrite() error: ") + strerror(errno));
+                }
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& writer : writers)
+        writer.join();
+    for (const auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
+
+
+// ~ Creates the file at filepath of filesize bytes and writes data to it unless allocateOnly is set
+// The data is flushed, so that the writeback does not overlap the measurement.
+static void CreateFile(const std::string& filepath, ui64 filesize, bool allocateOnly) {
+    int fd = open(filepath.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRWXU);
+    if (fd == -1)
+        throw std::runtime_error("Couldn't not create file \"" + filepath + "\"");
+
+    try {
+        bool allocated = false;
+        #if defined (__linux__)
+        allocated = (fallocate(fd, 0, 0, filesize) == 0);
+        #endif
+        // Filesystems without fallocate() support get a sparse file.
+        if (!allocated && ftruncate(fd, filesize) == -1)
+            throw std::runtime_error(std::string("CreateFile() ftruncate() error: ") + strerror(errno));
+
+        if (!allocateOnly)
+            FillFile(fd, filesize);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+
+    fdatasync(fd);
+    close(fd);
+}
+
+
+// ~ Makes dst a reflink copy of src, returns false if the filesystem does not support it
+static bool CloneFile(const std::string& src, const std::string& dst) {
+    #if defined (__linux__)
+    int srcFd = open(src.c_str(), O_RDONLY);
+    if (srcFd == -1)
+        return false;
+    int dstFd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+    if (dstFd == -1) {
+        close(srcFd);
+        return false;
+    }
+    bool cloned = (ioctl(dstFd, FICLONE, srcFd) == 0);
+    close(srcFd);
+    close(dstFd);
+    if (!cloned)
+        unlink(dst.c_str());
+    return cloned;
+    #else
+    return false;
+    #endif
+}
+
+
+TFixtureCache::~TFixtureCache() {
+    for (const auto& [key, fixture] : Fixtures) {
+        unlink(std::get<0>(key).c_str());
+        if (!fixture.GoldenPath.empty())
+            unlink(fixture.GoldenPath.c_str());
+    }
+}
+
+
+void TFixtureCache::Prepare(const std::string& filepath, ui64 filesize, EFillMode fillMode) {
+    TFixture& fixture = Fixtures[{filepath, filesize, fillMode}];
+    struct stat st;
+    if (fixture.Valid && stat(filepath.c_str(), &st) == 0 && (ui64)st.st_size == filesize)
+        return;
+
+    fixture.Valid = false;
+    LayOut(filepath, filesize, fillMode, fixture);
+    fixture.Valid = true;
+}
+
+
+void TFixtureCache::Invalidate() {
+    for (auto& [key, fixture] : Fixtures)
+        fixture.Valid = false;
+}
+
+
+void TFixtureCache::LayOut(const std::string& filepath, ui64 filesize, EFillMode fillMode, TFixture& fixture) {
+    unlink(filepath.c_str());
+    switch (fillMode) {
+    case EFillMode::Data:
+        CreateFile(filepath, filesize, false);
+        break;
+    case EFillMode::Allocate:
+        CreateFile(filepath, filesize, true);
+        break;
+    case EFillMode::Clone:
+        if (!fixture.CloneSupported) {
+            CreateFile(filepath, filesize, false);
+            break;
+        }
+        if (fixture.GoldenPath.empty()) {
+            fixture.GoldenPath = filepath + ".golden";
+            CreateFile(fixture.GoldenPath, filesize, false);
+        }
+        if (!CloneFile(fixture.GoldenPath, filepath)) {
+            // The golden copy becomes the test file, later layouts write the data.
+            if (rename(fixture.GoldenPath.c_str(), filepath.c_str()) == -1)
+                throw std::runtime_error(std::string("TFixtureCache::LayOut() rename() error: ") + strerror(errno));
+            fixture.GoldenPath.clear();
+            fixture.CloneSupported = false;
+        }
+        break;
+    default:
+        throw std::runtime_error("TFixtureCache::LayOut() error: fill mode " +
+                                 std::to_string(static_cast<ui32>(fillMode)) + " not supported");
+    }
+}
+
+
+
+
+
+
+#endif
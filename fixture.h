@@ -0,0 +1,64 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __FIXTURE__H__
+#define __FIXTURE__H__
+
+
+#include "globals.h"
+
+#include <string>
+#include <tuple>
+#include <map>
+
+
+// ~ Ways of laying out the contents of a test file
+enum class EFillMode : ui32 {
+    // ~ Every block is written by parallel writers
+    Data = 0,
+    // ~ Blocks are only allocated with fallocate(), reads of them return zeros
+    Allocate = 1,
+    // ~ Data is written once into a golden copy, which is then cloned (FICLONE)
+    // Falls back to Data if the filesystem does not support reflinks.
+    Clone = 2,
+};
+
+
+// ~ Cache of prepared test files
+// A file is laid out once per (path, size, fill mode) and reused until Invalidate().
+// The files laid out by the cache are removed when it is destroyed.
+class TFixtureCache {
+public:
+    TFixtureCache() = default;
+
+    TFixtureCache(const TFixtureCache&) = delete;
+
+    TFixtureCache& operator=(const TFixtureCache&) = delete;
+
+    ~TFixtureCache();
+
+    // ~ Makes sure the file at filepath is laid out with the given size and fill mode
+    void Prepare(const std::string& filepath, ui64 filesize, EFillMode fillMode);
+
+    // ~ Marks all the prepared files stale, so that they are laid out again on the next Prepare()
+    void Invalidate();
+
+private:
+    struct TFixture {
+        bool Valid = false;
+        // ~ Path of the golden copy (Clone mode only, empty if reflinks are not supported)
+        std::string GoldenPath;
+        bool CloneSupported = true;
+    };
+
+    void LayOut(const std::string& filepath, ui64 filesize, EFillMode fillMode, TFixture& fixture);
+
+private:
+    std::map<std::tuple<std::string, ui64, EFillMode>, TFixture> Fixtures;
+};
+
+
+
+
+
+
+#endif
@@ -5,13 +5,106 @@
 
 #include "globals.h"
 
-#include <cstdlib> // rand()
+#include <thread> // std::this_thread::sleep_for()
+#include <stdexcept> // std::runtime_error
 
+#if defined (__x86_64__)
+#include <cpuid.h> // __get_cpuid()
+#endif
+
+
+// ~ splitmix64 step used to expand a seed into the generator state
+static ui64 SplitMix64(ui64& x) {
+    ui64 z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+
+TRandom::TRandom(ui64 seed) {
+    Seed(seed);
+}
+
+void TRandom::Seed(ui64 seed) {
+    SeedValue = seed;
+    for (ui64& word : State)
+        word = SplitMix64(seed);
+}
 
-ui32 RandomUI32() {
-    return (rand() % 32768) * (rand() % 32768);
+ui64 TRandom::GetSeed() const {
+    return SeedValue;
 }
 
+
+void TClock::SetSource(ETimer source) {
+    switch (source) {
+    case ETimer::Default:
+    case ETimer::MonotonicRaw:
+        break;
+    case ETimer::Tsc: {
+        #if defined (__x86_64__)
+        // An invariant TSC ticks at a constant rate in all the P-, C- and T-states (CPUID 0x80000007, EDX bit 8).
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8)))
+            throw std::runtime_error("TClock::SetSource() error: the TSC is not invariant");
+
+        // Ticks are counted over a sleep of the raw monotonic clock. Each clock read lies between
+        // two TSC reads, so the narrowest of a few brackets bounds the error of an endpoint;
+        // the sleep is extended until both brackets are within 10 ppm of the counted ticks.
+        auto read = [](uint64_t& ticks, rep& time) {
+            uint64_t width = UINT64_MAX;
+            for (ui32 i = 0; i < 16; i++) {
+                uint64_t before = __rdtsc();
+                rep clock = MonotonicRaw();
+                uint64_t after = __rdtsc();
+                if (after > before && after - before < width) {
+                    width = after - before;
+                    ticks = before + width / 2;
+                    time = clock;
+                }
+            }
+            return width;
+        };
+        uint64_t startTicks = 0, endTicks = 0;
+        rep start = 0, end = 0;
+        uint64_t startWidth = read(startTicks, start);
+        uint64_t endWidth = UINT64_MAX;
+        auto precise = [&]() {
+            return endTicks > startTicks && startWidth / 2 + endWidth / 2 <= (endTicks - startTicks) / 100000;
+        };
+        do {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            endWidth = read(endTicks, end);
+        } while (!precise() && end - start < 1000000000);
+        if (!precise() || end <= start)
+            throw std::runtime_error("TClock::SetSource() error: TSC calibration failed");
+        TscMultiplier = (static_cast<unsigned __int128>(end - start) << 32) / (endTicks - startTicks);
+        TscBase = endTicks;
+        TscEpoch = end;
+        break;
+        #else
+        throw std::runtime_error("TClock::SetSource() error: TSC is only supported on x86-64");
+        #endif
+    }
+    default:
+        throw std::runtime_error("TClock::SetSource() error: timer " +
+                                 std::to_string(static_cast<ui32>(source)) + " not supported");
+    }
+    Source = source;
+}
+
+
+ld TClock::Cost() {
+    constexpr ui32 reads = 1000000;
+    time_point start = now();
+    time_point last = start;
+    for (ui32 i = 0; i < reads; i++)
+        last = now();
+    return static_cast<ld>((last - start).count()) / reads;
+}
+
+
 ui64 Duration(const TTimePoint& lhs, const TTimePoint& rhs) {
     return std::chrono::duration_cast<std::chrono::microseconds>(rhs - lhs).count();
 }
@@ -6,6 +6,11 @@
 
 #include <cstdint>
 #include <chrono>
+#include <ctime> // clock_gettime()
+
+#if defined (__x86_64__)
+#include <x86intrin.h> // __rdtsc()
+#endif
 
 
 using i32 = int32_t;
@@ -14,7 +19,84 @@ using ui64 = uint64_t;
 using ull = unsigned long long int;
 using ld = long double;
 
-using Nhrc = std::chrono::high_resolution_clock;
+
+
+// ~ Sources of the time measurements
+enum class ETimer : ui32 {
+    // ~ std::chrono::high_resolution_clock
+    Default = 0,
+    // ~ clock_gettime(CLOCK_MONOTONIC_RAW), steady and not slewed by NTP
+    MonotonicRaw = 1,
+    // ~ Time stamp counter calibrated against CLOCK_MONOTONIC_RAW (x86-64 with an invariant TSC)
+    Tsc = 2,
+};
+
+
+// ~ Clock of all the time measurements with a selectable source
+// Time points are nanoseconds since an epoch depending on the source,
+// so the source is expected to be set once before anything is measured.
+class TClock {
+public:
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<TClock>;
+    static constexpr bool is_steady = false;
+
+    static inline time_point now() noexcept {
+        switch (Source) {
+        case ETimer::MonotonicRaw:
+            return Now<ETimer::MonotonicRaw>();
+        case ETimer::Tsc:
+            return Now<ETimer::Tsc>();
+        default:
+            return Now<ETimer::Default>();
+        }
+    }
+
+    // ~ Reads the given source without the switch of now()
+    // Loops selecting their instantiation by GetSource() before the timer starts read the clock this way.
+    template <ETimer TSource>
+    static inline time_point Now() noexcept {
+        if constexpr (TSource == ETimer::MonotonicRaw)
+            return time_point(duration(MonotonicRaw()));
+        #if defined (__x86_64__)
+        else if constexpr (TSource == ETimer::Tsc)
+            // Ticks are converted by a 32.32 fixed point multiplier, no division on the hot path.
+            return time_point(duration(TscEpoch + static_cast<rep>(
+                (static_cast<unsigned __int128>(__rdtsc() - TscBase) * TscMultiplier) >> 32)));
+        #endif
+        else
+            return time_point(std::chrono::duration_cast<duration>(
+                std::chrono::high_resolution_clock::now().time_since_epoch()));
+    }
+
+    // ~ Selects the source, the TSC is calibrated against CLOCK_MONOTONIC_RAW first
+    static void SetSource(ETimer source);
+
+    static inline ETimer GetSource() noexcept {
+        return Source;
+    }
+
+    // ~ Measures the cost of a single now() call of the current source (in nanoseconds)
+    static ld Cost();
+
+private:
+    static inline rep MonotonicRaw() noexcept {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return static_cast<rep>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+private:
+    static inline ETimer Source = ETimer::Default;
+    // ~ Calibration of the TSC: the time of TscBase ticks and nanoseconds per tick (shifted by 32 bits)
+    static inline uint64_t TscBase = 0;
+    static inline rep TscEpoch = 0;
+    static inline uint64_t TscMultiplier = 0;
+};
+
+using Nhrc = TClock;
 using TTimePoint = Nhrc::time_point;
 
 
@@ -52,7 +134,50 @@ constexpr ui64 operator"" _min(ull value) {
 }
 
  
-ui32 RandomUI32();
+// ~ xoshiro256** pseudo-random generator
+// Not thread-safe: each thread is expected to own its generator.
+class TRandom {
+public:
+    explicit TRandom(ui64 seed = 0);
+
+    // ~ Resets the state, equal seeds produce equal sequences
+    void Seed(ui64 seed);
+
+    ui64 GetSeed() const;
+
+    inline ui64 Next() {
+        const ui64 result = Rotl(State[1] * 5, 7) * 9;
+        const ui64 t = State[1] << 17;
+        State[2] ^= State[0];
+        State[3] ^= State[1];
+        State[1] ^= State[2];
+        State[0] ^= State[3];
+        State[2] ^= t;
+        State[3] = Rotl(State[3], 45);
+        return result;
+    }
+
+    // ~ Returns a uniformly distributed value in [0, bound)
+    // Multiply-shift reduction: no division, bias is below bound / 2^64.
+    inline ui64 Uniform(ui64 bound) {
+        return static_cast<ui64>((static_cast<unsigned __int128>(Next()) * bound) >> 64);
+    }
+
+    // ~ Returns a uniformly distributed value in [0, 1)
+    inline double UniformReal() {
+        return (Next() >> 11) * 0x1.0p-53;
+    }
+
+private:
+    static inline ui64 Rotl(ui64 x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+private:
+    ui64 State[4];
+    ui64 SeedValue = 0;
+};
+
 
 ui64 Duration(const TTimePoint& lhs, const TTimePoint& rhs);
 
@@ -0,0 +1,64 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __HISTOGRAM__CPP__
+#define __HISTOGRAM__CPP__
+
+
+#include "histogram.h"
+
+#include <cmath> // sqrtl(), ceill()
+#include <algorithm> // std::max(), std::min()
+
+
+void THistogram::Merge(const THistogram& other) {
+    for (ui32 i = 0; i < Buckets; i++)
+        Counts[i] += other.Counts[i];
+    Count += other.Count;
+    Sum += other.Sum;
+    SquaresSum += other.SquaresSum;
+    Max = std::max(Max, other.Max);
+}
+
+
+void THistogram::Clear() {
+    Counts.fill(0);
+    Count = 0;
+    Sum = 0;
+    SquaresSum = 0;
+    Max = 0;
+}
+
+
+std::pair<ui64, ui64> THistogram::Statistics() const {
+    if (Count == 0)
+        return {0, 0};
+    ld mean = (ld)Sum / Count;
+    ld variance = (Count > 1 ? (SquaresSum - mean * Sum) / (Count - 1) : 0);
+    return {(ui64)mean, (ui64)sqrtl(std::max(variance, (ld)0))};
+}
+
+
+ui64 THistogram::Percentile(ld percent) const {
+    if (Count == 0)
+        return 0;
+    ui64 rank = std::max<ui64>(ceill(percent / 100 * Count), 1);
+    ui64 seen = 0;
+    for (ui32 i = 0; i < Buckets; i++) {
+        seen += Counts[i];
+        if (seen >= rank)
+            return std::min(HighestValue(i), Max);
+    }
+    return Max;
+}
+
+
+ui64 THistogram::HighestValue(ui32 index) {
+    if (index < (1u << Precision))
+        return index;
+    ui32 shift = index / HalfBuckets - 1;
+    ui64 lowest = (ui64)(index % HalfBuckets + HalfBuckets) << shift;
+    return lowest + ((1ull << shift) - 1);
+}
+
+
+#endif
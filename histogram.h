@@ -0,0 +1,70 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __HISTOGRAM__H__
+#define __HISTOGRAM__H__
+
+
+#include "globals.h"
+
+#include <array>
+#include <utility> // std::pair
+
+
+// ~ Log-linear (HDR-style) histogram of latencies
+// Values below 2^Precision are stored exactly, larger ones fall into buckets
+// with the relative width of 2^(1 - Precision) (< 1%). Memory is fixed,
+// recording takes O(1) and never allocates, so it is suitable for the hot loop.
+class THistogram {
+public:
+    // ~ Bits of precision: 2^(Precision - 1) buckets per power of two
+    static constexpr ui32 Precision = 8;
+    static constexpr ui32 HalfBuckets = 1u << (Precision - 1);
+    static constexpr ui32 Buckets = (64 - Precision + 2) * HalfBuckets;
+
+public:
+    void Add(ui64 value) {
+        Counts[Index(value)]++;
+        Count++;
+        Sum += value;
+        SquaresSum += (ld)value * value;
+        if (value > Max)
+            Max = value;
+    }
+
+    void Merge(const THistogram& other);
+
+    void Clear();
+
+    // ~ Returns a (mean, std) pair of the recorded values
+    std::pair<ui64, ui64> Statistics() const;
+
+    // ~ Returns the value below which the given percent of the recorded values fall
+    // The highest value equivalent to the found bucket is returned (capped by the maximum).
+    ui64 Percentile(ld percent) const;
+
+    ui64 GetCount() const { return Count; }
+
+    ui64 GetMax() const { return Max; }
+
+private:
+    static ui32 Index(ui64 value) {
+        if (value < (1ull << Precision))
+            return value;
+        ui32 msb = 63 - __builtin_clzll(value);
+        ui32 shift = msb - Precision + 1;
+        return shift * HalfBuckets + (value >> shift);
+    }
+
+    // ~ Returns the highest value falling into the bucket
+    static ui64 HighestValue(ui32 index);
+
+private:
+    std::array<ui64, Buckets> Counts = {};
+    ui64 Count = 0;
+    ui64 Sum = 0;
+    ld SquaresSum = 0;
+    ui64 Max = 0;
+};
+
+
+#endif
@@ -9,6 +9,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <unordered_map>
+#include <algorithm> // std::find()
 
 
 using std::cerr;
@@ -19,29 +20,72 @@ using std::cin;
 TExperimenter ReadExperiment() {
     cerr << "Please, enter experiment decription.\n";
     auto pattern = ReadPattern();
-    auto [factorLevels, varyingFactors] = ReadFactorLevels();
+    auto [factorLevels, varyingFactors] = ReadFactorLevels(pattern);
     auto warmup = ReadWarmupParams();
     auto environment = ReadEnvironmentParams();
     ui64 testDuration = ReadUI64("Test duration (ms)") * 1000;
     ui32 batchSize = ReadUI32("Batch size");
     ui32 replays = ReadUI32("Replays");
+    auto search = ReadSearchParams();
+    // Only the results of full experiments are plotted, which limits the varying factors.
+    if (search.Mode == ESearchMode::Full && varyingFactors.size() > 2)
+        throw std::runtime_error("There must be no more than 2 varying factors. " +
+                                 std::to_string(varyingFactors.size()) + " is specified");
     return TExperimenter(pattern, std::move(factorLevels), warmup, environment,
-                         testDuration, batchSize, replays, varyingFactors);
+                         testDuration, batchSize, replays, varyingFactors, search);
 }
 
 
 TPattern ReadPattern() {
     cerr << "Reading workload pattern.\n";
-    bool isConsecutive = ReadBool("Memory access is consecutive (random otherwise)");
-    bool isRead = ReadBool("Memory access operation is read (write otherwise)");
     TPattern pattern;
-    pattern.IsConsecutive = isConsecutive;
-    pattern.IsRead = isRead;
+    pattern.ConsecutivePercent = ReadPercent("Percentage of consecutive memory accesses (random otherwise)");
+    pattern.ReadPercent = ReadPercent("Percentage of read operations (write otherwise)");
+
+    ui32 sizes = ReadUI32("Number of operation sizes in the distribution (0 to use RS)");
+    ui64 total = 0;
+    for (ui32 i = 0; i < sizes; i++) {
+        ui64 size = ReadUI64("Operation size #" + std::to_string(i + 1) + " (B)");
+        ui64 percent = ReadPercent("Percentage of operations of size #" + std::to_string(i + 1));
+        pattern.RequestSizes.emplace_back(size, percent);
+        total += percent;
+    }
+    if (sizes > 0 && total != 100)
+        throw std::runtime_error("Percentages of operation sizes sum up to " + std::to_string(total) +
+                                 " instead of 100");
+
+    pattern.Distribution = ReadUI64("Access distribution [0 = uniform, 1 = zipfian, 2 = hotspot, 3 = pareto]");
+    switch (static_cast<EDistribution>(pattern.Distribution)) {
+    case EDistribution::Uniform:
+        break;
+    case EDistribution::Zipfian:
+        pattern.ZipfTheta = ReadUI64("Zipfian theta (in hundredths, 1 to 99)");
+        if (pattern.ZipfTheta == 0 || pattern.ZipfTheta >= 100)
+            throw std::runtime_error("Error reading theta: invalid value passed");
+        break;
+    case EDistribution::Hotspot:
+        pattern.HotOpsPercent = ReadPercent("Percentage of operations accessing the hot set");
+        pattern.HotSpacePercent = ReadPercent("Percentage of the file covered by the hot set");
+        break;
+    case EDistribution::Pareto:
+        pattern.ParetoShape = ReadUI64("Pareto shape (in hundredths, above 100, 116 for 80/20)");
+        if (pattern.ParetoShape <= 100)
+            throw std::runtime_error("Error reading shape: invalid value passed");
+        break;
+    default:
+        throw std::runtime_error("Error reading access distribution: invalid value passed");
+    }
+
+    cerr << "Trace to replay (empty for the synthetic workload): ";
+    cin.get();
+    getline(cin, pattern.TracePath);
+    if (!pattern.TracePath.empty())
+        pattern.TraceTiming = ReadBool("Replay at the original pace");
     return pattern;
 }
 
 
-std::pair<std::vector<TFactorLevels>, std::vector<std::string>> ReadFactorLevels() {
+std::pair<std::vector<TFactorLevels>, std::vector<std::string>> ReadFactorLevels(const TPattern& pattern) {
     cerr << "Reading factors.\n";
 
     ui32 factors;
@@ -63,12 +107,8 @@ std::pair<std::vector<TFactorLevels>, std::vector<std::string>> ReadFactorLevels
             varyingFactors.push_back(factor);
     }
 
-    if (varyingFactors.size() > 2)
-        throw std::runtime_error("There must be no more than 2 varying factors. " +
-                                 std::to_string(varyingFactors.size()) + " is specified");
-
     // Generate all factor combinations as cartesian product
-    std::vector<TFactorLevels> combinations(1);
+    std::vector<TFactorLevels> combinations(1, TFactorLevels(pattern));
     for (const auto [factor, levels] : factorsMap) {
         ui32 n = combinations.size();
         ui32 m = levels.size();
@@ -82,6 +122,14 @@ std::pair<std::vector<TFactorLevels>, std::vector<std::string>> ReadFactorLevels
             }
     }
 
+    // Combinations the engines reject are reported before the experiment starts.
+    for (const auto& levels : combinations) {
+        if (static_cast<EEngine>(levels.Engine) == EEngine::LinuxAio && !levels.DirectIO)
+            throw std::runtime_error("ENGINE = 2 (Linux AIO) requires DIO = 1 in every combination");
+        if (static_cast<EEngine>(levels.Engine) == EEngine::IoUring && levels.IoPoll && !levels.DirectIO)
+            throw std::runtime_error("IOPOLL = 1 requires DIO = 1 in every combination");
+    }
+
     return {combinations, varyingFactors};
 }
 
@@ -97,20 +145,107 @@ std::pair<std::string, std::vector<ui64>> ReadFactor() {
          << "Default: 8\n"
          << "\"DIO\" for Direct IO\n"
          << "Range: {0, 1}\n"
+         << "Default: 0\n"
+         << "\"ENGINE\" for I/O engine\n"
+         << "Range: {0 = POSIX, 1 = io_uring, 2 = Linux AIO (requires DIO = 1), 3 = mmap, 4 = null (no I/O),\n"
+         << "        5 = preadv2}\n"
+         << "Default: 0\n"
+         << "\"SQPOLL\", \"IOPOLL\" for io_uring submission and completion polling\n"
+         << "Range: {0, 1} (IOPOLL requires DIO = 1)\n"
+         << "Default: 0\n"
+         << "\"FIXBUF\", \"FIXFILE\" for io_uring registered buffers and file\n"
+         << "Range: {0, 1}\n"
+         << "Default: 0\n"
+         << "\"THREADS\" for the number of worker threads\n"
+         << "Recommended range: [1, 64]\n"
+         << "Default: 1\n"
+         << "\"SHARED\" for workers sharing the whole file (disjoint regions otherwise)\n"
+         << "Range: {0, 1}\n"
+         << "Default: 0\n"
+         << "\"READ\" for the percentage of read operations\n"
+         << "\"SEQ\" for the percentage of consecutive memory accesses\n"
+         << "Range: [0, 100]\n"
+         << "Default: taken from the workload pattern\n"
+         << "\"HUGEBUF\" for buffers backed by huge pages\n"
+         << "Range: {0, 1}\n"
+         << "Default: 0\n"
+         << "\"MAPPOP\", \"MAPHUGE\", \"MSYNC\" for mmap populated, huge pages and msync()-ed mapping\n"
+         << "Range: {0, 1}\n"
+         << "Default: 0\n"
+         << "MAPHUGE = 1 requires the file on tmpfs, other filesystems ignore huge page advice for file mappings\n"
+         << "\"HIPRI\", \"NOWAIT\", \"DSYNC\", \"APPEND\" for the RWF_* flags of preadv2 operations\n"
+         << "Range: {0, 1} (NOWAIT applies to reads, DSYNC and APPEND to writes)\n"
+         << "Default: 0\n"
+         << "\"SYNC\" for the durability of writes\n"
+         << "Range: {0 = none, 1 = fsync(), 2 = fdatasync(), 3 = O_DSYNC, 4 = sync_file_range() of the written range}\n"
+         << "Default: 0\n"
+         << "\"SYNCN\" for the number of writes of a worker per flush\n"
+         << "Recommended range: [1, 1024]\n"
+         << "Default: 1\n"
+         << "\"WAL\" for the append workload with group commit (records of RS bytes, fdatasync())\n"
+         << "Range: {0 = off, 1 = appends at reserved offsets, 2 = O_APPEND}\n"
+         << "Default: 0\n"
+         << "\"GROUP\" for the number of records pending before a group commit flush\n"
+         << "Recommended range: [1, THREADS]\n"
+         << "Default: 1\n"
+         << "\"PREALLOC\" for preallocating the log of the append workload\n"
+         << "Range: {0, 1}\n"
+         << "Default: 0\n"
+         << "\"CACHE\" for the page cache state of the file set after the warmup of each test\n"
+         << "Range: {0 = as is, 1 = cold, 2 = warm, 3 = partially warm}\n"
+         << "Default: 0\n"
+         << "\"WARMPCT\" for the percentage of the file warmed in the partially warm state\n"
+         << "Range: [0, 100]\n"
+         << "Default: 50\n"
+         << "\"FADV\" for the posix_fadvise() access advice for the file\n"
+         << "Range: {0 = normal, 1 = sequential, 2 = random, 3 = noreuse}\n"
+         << "Default: 0\n"
+         << "\"RAHEAD\" for the window of readahead(2) ahead of the consecutive accesses (in bytes, 0 for none)\n"
+         << "Recommended range: [128KB, 16MB]\n"
+         << "Default: 0\n"
+         << "\"BLKRA\" for the readahead of the block device under test (in KB, 0 leaves it as is, requires root)\n"
+         << "Recommended range: [4, 16384]\n"
+         << "Default: 0\n"
+         << "\"MADV\" for mmap access advice\n"
+         << "Range: {0 = normal, 1 = sequential, 2 = random, 3 = willneed}\n"
+         << "Default: 0\n"
+         << "\"DIST\" for the distribution of random offsets\n"
+         << "Range: {0 = uniform, 1 = zipfian, 2 = hotspot, 3 = pareto}\n"
+         << "\"THETA\", \"PARETO\" for zipfian theta and pareto shape (in hundredths)\n"
+         << "\"HOTOPS\", \"HOTSPACE\" for the hotspot operations and file percentages\n"
+         << "\"TRACETIME\" for replaying the trace at the original pace\n"
+         << "Default: taken from the workload pattern\n"
+         << "\"RATE\" for the target operations per second of open-loop load (0 for closed-loop)\n"
+         << "Default: 0\n"
+         << "\"ARRIVAL\" for the open-loop arrival process\n"
+         << "Range: {0 = constant, 1 = poisson, 2 = bursty on/off}\n"
          << "Default: 0\n";
+    const std::vector<std::string>& supported = FactorNames;
+    std::string supportedList;
+    for (const auto& name : supported)
+        supportedList += (supportedList.empty() ? "" : ", ") + ("\"" + name + "\"");
+
     std::string factor;
-    cerr << "Factor name [\"RS\", \"QD\", \"DIO\"]: ";
+    cerr << "Factor name [" << supportedList << "]: ";
     cin >> factor;
-    if (factor != "RS" && factor != "QD" && factor != "DIO")
-        throw std::runtime_error("Incorrect factor name: \"" + factor + "\""
-                            "Supported values are: \"RS\", \"QD\", \"DIO\".");
+    if (std::find(supported.begin(), supported.end(), factor) == supported.end())
+        throw std::runtime_error("Incorrect factor name: \"" + factor + "\". "
+                            "Supported values are: " + supportedList + ".");
 
     ui32 levels = ReadUI32("Factor levels count");
     if (levels == 0)
         throw std::runtime_error("You entered a factor with 0 levels");
     std::vector<ui64> factorLevels(levels);
-    for (ui32 i = 0; i < levels; i++)
+    for (ui32 i = 0; i < levels; i++) {
         factorLevels[i] = ReadUI64("Factor level #" + std::to_string(i + 1));
+        if ((factor == "READ" || factor == "SEQ" || factor == "WARMPCT") && factorLevels[i] > 100)
+            throw std::runtime_error("Factor " + factor + " is a percentage, level " +
+                                     std::to_string(factorLevels[i]) + " is out of range");
+        if ((factor == "CACHE" && factorLevels[i] > static_cast<ui64>(ECacheState::Partial)) ||
+            (factor == "FADV" && factorLevels[i] > static_cast<ui64>(EFileAdvice::NoReuse)))
+            throw std::runtime_error("Factor " + factor + " level " + std::to_string(factorLevels[i]) +
+                                     " is not supported");
+    }
 
     return {factor, factorLevels};
 }
@@ -120,13 +255,13 @@ TWarmupParams ReadWarmupParams() {
     cerr << "Reading warmup parameters.\n";
     TWarmupParams warmup;
 
-    cerr << "Threshold coefficient (double): ";
+    cerr << "Threshold coefficient (double, allowed range of the round means relative to their average): ";
     cin >> warmup.ThresholdCoef;
     if (cin.fail())
         throw std::runtime_error("Error reading double: invalid value passed");
 
     warmup.MaxDuration = ReadUI64("Max duration (ms)") * 1000;
-    warmup.SampleSize = ReadUI32("Sample size (used in calculating mean and std)");
+    warmup.SampleSize = ReadUI32("Sample size (batch latencies in a round)");
 
     return warmup;
 }
@@ -141,16 +276,63 @@ TEnvironmentParams ReadEnvironmentParams() {
     getline(cin, environment.Filepath);
 
     environment.Filesize = ReadUI64("Filesize (MB)") * 1024 * 1024;
+    if (environment.Filesize == 0)
+        throw std::runtime_error("Error reading filesize: positive value was expected");
     environment.Unlink = ReadBool("Unlink file at filepath");
+    ui32 fillMode = ReadUI32("File fill mode [0 = data, 1 = allocate only, 2 = clone a golden copy]");
+    if (fillMode > static_cast<ui32>(EFillMode::Clone))
+        throw std::runtime_error("Error reading fill mode: invalid value passed");
+    environment.FillMode = static_cast<EFillMode>(fillMode);
+    environment.InvalidateFixtures = ReadBool("Lay out the file anew between replays");
+    environment.Seed = ReadUI64("Random seed (0 = take a random one)");
+
+    // The test duration remains the time cap of the runs stopped by the precision.
+    cerr << "Throughput confidence interval precision (percent of the mean, 0 = fixed test duration): ";
+    cin >> environment.Precision;
+    if (cin.fail() || environment.Precision < 0)
+        throw std::runtime_error("Error reading precision: non-negative double was expected");
+    environment.Precision /= 100;
+
+    ui32 timer = ReadUI32("Timer [0 = high_resolution_clock, 1 = CLOCK_MONOTONIC_RAW, 2 = TSC]");
+    if (timer > static_cast<ui32>(ETimer::Tsc))
+        throw std::runtime_error("Error reading timer: invalid value passed");
+    environment.Timer = static_cast<ETimer>(timer);
+    environment.Calibrate = ReadBool("Measure the harness overhead against the null engine");
+
+    cerr << "Time series file (empty for none): ";
+    cin.get();
+    getline(cin, environment.TimeSeriesPath);
+    if (!environment.TimeSeriesPath.empty()) {
+        environment.TimeSeriesInterval = ReadUI64("Time series interval (ms)") * 1000;
+        cin.get(); // ~ The line is finished as it is after an empty path
+    }
+
+    cerr << "Raw samples file (empty for none): ";
+    getline(cin, environment.SamplesPath);
 
     cerr << "Preparation script: ";
-    cin.get();
     getline(cin, environment.PreparationScript);
 
     return environment;
 }
 
 
+TSearchParams ReadSearchParams() {
+    cerr << "Reading search parameters.\n";
+    TSearchParams search;
+    ui32 mode = ReadUI32("Experiment mode [0 = measure all the combinations, 1 = search for the highest throughput, "
+                         "2 = search for the lowest p99 latency above a throughput floor]");
+    if (mode > static_cast<ui32>(ESearchMode::MinP99))
+        throw std::runtime_error("Error reading experiment mode: invalid value passed");
+    search.Mode = static_cast<ESearchMode>(mode);
+    if (search.Mode == ESearchMode::MinP99)
+        search.ThroughputFloor = ReadUI64("Throughput floor (MB/s)") * 1_MB;
+    if (search.Mode != ESearchMode::Full)
+        search.Budget = ReadUI32("Budget of benchmark runs (0 = unlimited)");
+    return search;
+}
+
+
 bool ReadBool(const std::string& message) {
     ui64 result;
     cerr << message << " [0 or 1]: ";
@@ -171,6 +353,14 @@ ui64 ReadUI64(const std::string& message) {
 }
 
 
+ui64 ReadPercent(const std::string& message) {
+    ui64 result = ReadUI64(message + " [0, 100]");
+    if (result > 100)
+        throw std::runtime_error("Error reading percentage: value is out of [0, 100] range");
+    return result;
+}
+
+
 ui32 ReadUI32(const std::string& message) {
     ui32 result;
     cerr << message << ": ";
@@ -181,17 +371,18 @@ ui32 ReadUI32(const std::string& message) {
 }
 
 
-void PrintExperimentResults(const std::vector<std::pair<ui64, ui64>>& result,
+void PrintExperimentResults(const std::vector<TTestResult>& result,
                             TPattern pattern,
                             const std::vector<TFactorLevels>& factorLevels,
                             const std::vector<std::string>& varyingFactors) {
-    cout << pattern.IsConsecutive << "\n";
-    cout << pattern.IsRead << "\n";
+    cout << pattern.ConsecutivePercent << "\n";
+    cout << pattern.ReadPercent << "\n";
     cout << result.size() << "\n";
     ui32 factorsCnt = varyingFactors.size();
     cout << (factorsCnt <= 2 ? factorsCnt : 0) << "\n";
     for (ui64 i = 0; i < result.size(); i++) {
-        auto [mean, std] = result[i];
+        auto [mean, std] = result[i].Throughput;
+        auto [opMean, opStd] = result[i].OpLatency;
         if (factorsCnt >= 1 && factorsCnt <= 2)
             cout << varyingFactors[0] << "\n"
                  << factorLevels[i].GetLevel(varyingFactors[0]) << "\n";
@@ -199,7 +390,52 @@ void PrintExperimentResults(const std::vector<std::pair<ui64, ui64>>& result,
             cout << varyingFactors[1] << "\n"
                  << factorLevels[i].GetLevel(varyingFactors[1]) << "\n";
         cout << mean << "\n"
-             << std << "\n";
+             << std << "\n"
+             << result[i].ThroughputCI << "\n"
+             << opMean << "\n"
+             << opStd << "\n"
+             << result[i].OpLatencyP50 << "\n"
+             << result[i].OpLatencyP90 << "\n"
+             << result[i].OpLatencyP99 << "\n"
+             << result[i].OpLatencyP999 << "\n"
+             << result[i].OpLatencyMax << "\n"
+             << result[i].Fairness << "\n"
+             << result[i].MinorFaults << "\n"
+             << result[i].MajorFaults << "\n"
+             << result[i].Resident << "\n"
+             << result[i].WouldBlock << "\n"
+             << result[i].Flushes << "\n"
+             << result[i].FlushLatency.first << "\n"
+             << result[i].FlushLatency.second << "\n"
+             << result[i].FlushLatencyP99 << "\n"
+             << result[i].FlushLatencyMax << "\n"
+             << result[i].HarnessOverhead << "\n";
+    }
+}
+
+
+void PrintSearchResults(const TSearchResult& result,
+                        const std::vector<TFactorLevels>& factorLevels,
+                        const std::vector<std::string>& varyingFactors) {
+    cout << "Best:";
+    for (const auto& factor : varyingFactors)
+        cout << " " << factor << "=" << factorLevels[result.Best].GetLevel(factor);
+    cout << "\n"
+         << "Throughput: " << result.Throughput.first << " " << result.Throughput.second << "\n"
+         << "OpLatencyP99: " << result.OpLatencyP99.first << " " << result.OpLatencyP99.second << "\n"
+         << "Runs: " << result.Runs << "\n";
+
+    cout << "Trajectory: " << result.Trajectory.size() << "\n"
+         << "run,stage,test";
+    for (const auto& factor : varyingFactors)
+        cout << "," << factor;
+    cout << ",throughput,p99\n";
+    for (ui64 i = 0; i < result.Trajectory.size(); i++) {
+        const auto& step = result.Trajectory[i];
+        cout << (i + 1) << "," << step.Stage << "," << step.Test;
+        for (const auto& factor : varyingFactors)
+            cout << "," << factorLevels[step.Test].GetLevel(factor);
+        cout << "," << step.Throughput << "," << step.OpLatencyP99 << "\n";
     }
 }
 
@@ -15,7 +15,7 @@ TExperimenter ReadExperiment();
 
 TPattern ReadPattern();
 
-std::pair<std::vector<TFactorLevels>, std::vector<std::string>> ReadFactorLevels();
+std::pair<std::vector<TFactorLevels>, std::vector<std::string>> ReadFactorLevels(const TPattern& pattern);
 
 std::pair<std::string, std::vector<ui64>> ReadFactor();
 
@@ -23,6 +23,8 @@ TWarmupParams ReadWarmupParams();
 
 TEnvironmentParams ReadEnvironmentParams();
 
+TSearchParams ReadSearchParams();
+
 
 bool ReadBool(const std::string& message);
 
@@ -30,12 +32,19 @@ ui64 ReadUI64(const std::string& message);
 
 ui32 ReadUI32(const std::string& message);
 
+ui64 ReadPercent(const std::string& message);
+
 
-void PrintExperimentResults(const std::vector<std::pair<ui64, ui64>>& results,
+void PrintExperimentResults(const std::vector<TTestResult>& results,
                             TPattern pattern,
                             const std::vector<TFactorLevels>& factorLevels,
                             const std::vector<std::string>& varyingFactors);
 
+// ~ Prints the best combination found by the search and all the runs it took
+void PrintSearchResults(const TSearchResult& result,
+                        const std::vector<TFactorLevels>& factorLevels,
+                        const std::vector<std::string>& varyingFactors);
+
 
 void SetLevel(TFactorLevels& levels, const std::string& factor, ui64 level);
 
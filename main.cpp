@@ -12,6 +12,12 @@
 int main() {
     //RunTests();
     auto experimenter = ReadExperiment();
+    if (experimenter.GetSearchParams().Mode != ESearchMode::Full) {
+        PrintSearchResults(experimenter.Search(),
+                           experimenter.GetFactorLevels(),
+                           experimenter.GetVaryingFactors());
+        return 0;
+    }
     auto results = experimenter.Experiment();
     PrintExperimentResults(results,
                            experimenter.GetPattern(),
@@ -0,0 +1,368 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __SAMPLES__CPP__
+#define __SAMPLES__CPP__
+
+
+#include "samples.h"
+
+#include <sys/mman.h> // mmap(), munmap(), madvise()
+#include <sys/stat.h> // fstat()
+#include <fcntl.h> // open()
+#include <unistd.h> // write(), close()
+#include <cerrno> // errno
+#include <cstring> // memcmp(), strerror()
+#include <cstdio> // sscanf()
+#include <stdexcept> // runtime_error
+
+
+// ~ Variable-length encoding of the columns
+static inline void PutVarint(std::string& out, ui64 value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static inline ui64 GetVarint(const char*& in) {
+    ui64 value = 0;
+    for (ui32 shift = 0; ; shift += 7) {
+        unsigned char byte = *in++;
+        value |= static_cast<ui64>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+}
+
+static inline ui64 ZigZag(ui64 delta) {
+    return (delta << 1) ^ static_cast<ui64>(static_cast<int64_t>(delta) >> 63);
+}
+
+static inline ui64 UnZigZag(ui64 value) {
+    return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+
+// ~ TSampleWriter
+TSampleWriter::TSampleWriter(const std::string& path, const std::string& description) {
+    Fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (Fd == -1)
+        throw std::runtime_error("Couldn't not open samples file \"" + path + "\"");
+    try {
+        WriteAll(SamplesMagic, sizeof(SamplesMagic));
+        WriteChunk(ESampleChunk::Description, description);
+    } catch (...) {
+        close(Fd);
+        throw;
+    }
+    RunStart = Nhrc::now();
+    Thread = std::thread([this]() { Work(); });
+}
+
+TSampleWriter::~TSampleWriter() {
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Stopping = true;
+    }
+    Changed.notify_all();
+    Thread.join();
+    close(Fd);
+}
+
+void TSampleWriter::StartRun(ui32 test, const std::string& levels) {
+    Drain();
+    Run++;
+    RunStart = Nhrc::now();
+    WriteChunk(ESampleChunk::Run, "run=" + std::to_string(Run) + "\ntest=" + std::to_string(test) + "\n" + levels);
+}
+
+TTimePoint TSampleWriter::GetRunStart() const {
+    return RunStart;
+}
+
+std::unique_ptr<TSampleBlock> TSampleWriter::AcquireBlock() {
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (!Free.empty()) {
+            auto block = std::move(Free.back());
+            Free.pop_back();
+            return block;
+        }
+    }
+    auto block = std::make_unique<TSampleBlock>();
+    block->Samples.reserve(BlockSamples);
+    return block;
+}
+
+void TSampleWriter::Submit(std::unique_ptr<TSampleBlock> block) {
+    std::unique_lock<std::mutex> lock(Mutex);
+    // Workers wait for the disk rather than let the queue take all the memory.
+    Changed.wait(lock, [this]() { return Pending.size() < MaxPendingBlocks || !Error.empty(); });
+    if (!Error.empty())
+        throw std::runtime_error(Error);
+    Pending.push_back(std::move(block));
+    Changed.notify_all();
+}
+
+void TSampleWriter::Work() {
+    std::unique_lock<std::mutex> lock(Mutex);
+    while (true) {
+        Changed.wait(lock, [this]() { return !Pending.empty() || Stopping; });
+        if (Pending.empty())
+            return;
+        auto block = std::move(Pending.front());
+        Pending.pop_front();
+        Writing = true;
+        lock.unlock();
+
+        std::string error;
+        try {
+            WriteBlock(*block);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        block->Samples.clear();
+
+        lock.lock();
+        Writing = false;
+        if (!error.empty())
+            Error = error;
+        Free.push_back(std::move(block));
+        Changed.notify_all();
+    }
+}
+
+void TSampleWriter::Drain() {
+    std::unique_lock<std::mutex> lock(Mutex);
+    Changed.wait(lock, [this]() { return Pending.empty() && !Writing; });
+    if (!Error.empty())
+        throw std::runtime_error(Error);
+}
+
+void TSampleWriter::WriteBlock(const TSampleBlock& block) {
+    TSampleBlockHeader header = {};
+    header.Run = Run;
+    header.Worker = block.Worker;
+    header.Count = block.Samples.size();
+
+    // Columns are appended to the buffer one after another.
+    Buffer.assign(sizeof(header), '\0');
+    ui64 previous = 0;
+    for (const auto& sample : block.Samples) {
+        PutVarint(Buffer, ZigZag(sample.Timestamp - previous));
+        previous = sample.Timestamp;
+    }
+    header.TimestampsSize = Buffer.size() - sizeof(header);
+    for (const auto& sample : block.Samples)
+        PutVarint(Buffer, sample.Latency);
+    header.LatenciesSize = Buffer.size() - sizeof(header) - header.TimestampsSize;
+    previous = 0;
+    for (const auto& sample : block.Samples) {
+        PutVarint(Buffer, ZigZag(sample.Offset - previous));
+        previous = sample.Offset;
+    }
+    header.OffsetsSize = Buffer.size() - sizeof(header) - header.TimestampsSize - header.LatenciesSize;
+    for (const auto& sample : block.Samples)
+        Buffer.push_back(static_cast<char>(sample.Op));
+    header.OpsSize = header.Count;
+
+    memcpy(&Buffer[0], &header, sizeof(header));
+    WriteChunk(ESampleChunk::Samples, Buffer);
+}
+
+void TSampleWriter::WriteChunk(ESampleChunk type, const std::string& payload) {
+    TSampleChunkHeader header = {static_cast<ui32>(type), 0, payload.size()};
+    WriteAll(&header, sizeof(header));
+    WriteAll(payload.data(), payload.size());
+}
+
+void TSampleWriter::WriteAll(const void* data, size_t size) {
+    const char* position = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = write(Fd, position, size);
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error(std::string("TSampleWriter write() error: ") + strerror(errno));
+        }
+        position += written;
+        size -= written;
+    }
+}
+
+
+// ~ TSampleStream
+TSampleStream::TSampleStream(TSampleWriter& writer, ui32 worker)
+    : Writer(writer)
+    , Worker(worker)
+    , RunStart(writer.GetRunStart())
+    , Block(Acquire())
+    , Spare(Acquire()) {}
+
+TSampleStream::~TSampleStream() {
+    // Errors are reported by the explicit Flush() at the end of a run.
+    try {
+        Flush();
+    } catch (...) {
+    }
+}
+
+void TSampleStream::Flush() {
+    Handoff();
+    if (Block->Samples.empty())
+        return;
+    Writer.Submit(std::move(Block));
+    Block = Acquire();
+}
+
+void TSampleStream::SubmitFull() {
+    Writer.Submit(std::move(Full));
+    Spare = Acquire();
+}
+
+std::unique_ptr<TSampleBlock> TSampleStream::Acquire() {
+    auto block = Writer.AcquireBlock();
+    block->Worker = Worker;
+    return block;
+}
+
+
+// ~ TSampleReader
+TSampleReader::TSampleReader(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error("Couldn't not open samples file \"" + path + "\"");
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (ui64)st.st_size < sizeof(SamplesMagic)) {
+        close(fd);
+        throw std::runtime_error("Samples file \"" + path + "\" is too short");
+    }
+
+    MappingSize = st.st_size;
+    Mapping = mmap(nullptr, MappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (Mapping == MAP_FAILED) {
+        Mapping = nullptr;
+        throw std::runtime_error(std::string("TSampleReader() mmap() error: ") + strerror(errno));
+    }
+    // The blocks are decoded once in order.
+    madvise(Mapping, MappingSize, MADV_SEQUENTIAL);
+    if (memcmp(Mapping, SamplesMagic, sizeof(SamplesMagic)) != 0) {
+        munmap(Mapping, MappingSize);
+        Mapping = nullptr;
+        throw std::runtime_error("\"" + path + "\" is not a valid samples file");
+    }
+
+    // Collect the text chunks, a file cut short by a crash is read up to the last whole chunk.
+    const char* data = static_cast<const char*>(Mapping);
+    ui64 position = sizeof(SamplesMagic);
+    while (position + sizeof(TSampleChunkHeader) <= MappingSize) {
+        TSampleChunkHeader header;
+        memcpy(&header, data + position, sizeof(header));
+        position += sizeof(header);
+        if (header.Size > MappingSize - position)
+            break;
+        std::string text(data + position, (header.Type == static_cast<ui32>(ESampleChunk::Samples) ? 0 : header.Size));
+        if (header.Type == static_cast<ui32>(ESampleChunk::Description)) {
+            Description = text;
+        } else if (header.Type == static_cast<ui32>(ESampleChunk::Run)) {
+            TRun run;
+            if (sscanf(text.c_str(), "run=%u\ntest=%u\n", &run.Run, &run.Test) != 2) {
+                munmap(Mapping, MappingSize);
+                Mapping = nullptr;
+                throw std::runtime_error("\"" + path + "\" has a malformed run chunk");
+            }
+            run.Levels = text;
+            Runs.push_back(run);
+        }
+        position += header.Size;
+    }
+}
+
+TSampleReader::~TSampleReader() {
+    if (Mapping)
+        munmap(Mapping, MappingSize);
+}
+
+const std::string& TSampleReader::GetDescription() const {
+    return Description;
+}
+
+const std::vector<TSampleReader::TRun>& TSampleReader::GetRuns() const {
+    return Runs;
+}
+
+void TSampleReader::ForEachBlock(const std::function<void(ui32 test, const TSampleBlockHeader&, const char* columns)>& visit) const {
+    const char* data = static_cast<const char*>(Mapping);
+    ui64 position = sizeof(SamplesMagic);
+    ui32 runs = 0;
+    while (position + sizeof(TSampleChunkHeader) <= MappingSize) {
+        TSampleChunkHeader header;
+        memcpy(&header, data + position, sizeof(header));
+        position += sizeof(header);
+        if (header.Size > MappingSize - position)
+            break;
+        if (header.Type == static_cast<ui32>(ESampleChunk::Run)) {
+            runs++;
+        } else if (header.Type == static_cast<ui32>(ESampleChunk::Samples) && runs > 0) {
+            TSampleBlockHeader block;
+            if (header.Size < sizeof(block))
+                throw std::runtime_error("TSampleReader error: malformed samples chunk");
+            memcpy(&block, data + position, sizeof(block));
+            if (block.TimestampsSize + block.LatenciesSize + block.OffsetsSize + block.OpsSize != header.Size - sizeof(block)
+                || block.OpsSize != block.Count)
+                throw std::runtime_error("TSampleReader error: malformed samples chunk");
+            visit(Runs[runs - 1].Test, block, data + position + sizeof(block));
+        }
+        position += header.Size;
+    }
+}
+
+void TSampleReader::ForEach(const TFilter& filter, const std::function<void(ui32 worker, const TSample&)>& visit) const {
+    ForEachBlock([&](ui32 test, const TSampleBlockHeader& block, const char* columns) {
+        if ((filter.Run != ~0u && filter.Run != block.Run)
+            || (filter.Test != ~0u && filter.Test != test)
+            || (filter.Worker != ~0u && filter.Worker != block.Worker))
+            return;
+        const char* timestamps = columns;
+        const char* latencies = timestamps + block.TimestampsSize;
+        const char* offsets = latencies + block.LatenciesSize;
+        const char* ops = offsets + block.OffsetsSize;
+        TSample sample = {0, 0, 0, 0};
+        for (ui64 i = 0; i < block.Count; i++) {
+            sample.Timestamp += UnZigZag(GetVarint(timestamps));
+            sample.Latency = GetVarint(latencies);
+            sample.Offset += UnZigZag(GetVarint(offsets));
+            sample.Op = static_cast<unsigned char>(ops[i]);
+            if (filter.Op == ~0u || filter.Op == sample.Op)
+                visit(block.Worker, sample);
+        }
+    });
+}
+
+THistogram TSampleReader::Latencies(const TFilter& filter) const {
+    THistogram histogram;
+    ForEachBlock([&](ui32 test, const TSampleBlockHeader& block, const char* columns) {
+        if ((filter.Run != ~0u && filter.Run != block.Run)
+            || (filter.Test != ~0u && filter.Test != test)
+            || (filter.Worker != ~0u && filter.Worker != block.Worker))
+            return;
+        // Only the latencies column is decoded unless the samples are filtered by the operation.
+        const char* latencies = columns + block.TimestampsSize;
+        const char* ops = latencies + block.LatenciesSize + block.OffsetsSize;
+        for (ui64 i = 0; i < block.Count; i++) {
+            ui64 latency = GetVarint(latencies);
+            if (filter.Op == ~0u || filter.Op == static_cast<unsigned char>(ops[i]))
+                histogram.Add(latency);
+        }
+    });
+    return histogram;
+}
+
+
+
+
+
+
+#endif
@@ -0,0 +1,260 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __SAMPLES__H__
+#define __SAMPLES__H__
+
+
+#include "globals.h"
+#include "histogram.h"
+
+#include <sys/types.h> // off_t
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory> // std::unique_ptr
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional> // std::function
+
+
+// ~ Magic bytes starting a samples file
+constexpr char SamplesMagic[8] = {'I', 'O', 'S', 'M', 'P', 'L', 'S', '1'};
+
+
+// ~ Types of the chunks of a samples file
+enum class ESampleChunk : ui32 {
+    // ~ Text describing the pattern and the environment of the experiment
+    Description = 0,
+    // ~ Text starting a run: "run", "test" and the factor levels as "NAME=value" lines
+    Run = 1,
+    // ~ Block of samples of a single worker of the last started run
+    Samples = 2,
+};
+
+
+// ~ Header of a chunk
+// A samples file is the magic followed by chunks, each one is the header and Size bytes of payload.
+// All the fields are little-endian.
+struct TSampleChunkHeader {
+    ui32 Type;
+    ui32 Reserved;
+    ui64 Size;
+};
+
+
+// ~ Header of the payload of a samples chunk
+// It is followed by the timestamps, latencies, offsets and ops columns.
+// Timestamps and offsets are zigzag-encoded deltas from the previous sample of the block
+// (the first timestamp is relative to the start of the run, the first offset is absolute),
+// latencies are plain values. All of them are LEB128 varints. Ops take a byte each.
+struct TSampleBlockHeader {
+    ui32 Run;
+    ui32 Worker;
+    ui64 Count;
+    // ~ Sizes of the encoded columns (in bytes)
+    ui64 TimestampsSize;
+    ui64 LatenciesSize;
+    ui64 OffsetsSize;
+    ui64 OpsSize;
+};
+
+static_assert(sizeof(TSampleChunkHeader) == 16 && sizeof(TSampleBlockHeader) == 48,
+              "Samples layout must not be padded");
+
+
+// ~ Single operation sample
+struct TSample {
+    // ~ Completion time since the start of the run and latency (in nanoseconds)
+    ui64 Timestamp;
+    ui64 Latency;
+    ui64 Offset;
+    // ~ Operation (see ETraceOp)
+    ui32 Op;
+};
+
+
+// ~ Block of raw samples collected by a worker
+struct TSampleBlock {
+    ui32 Worker = 0;
+    std::vector<TSample> Samples;
+};
+
+
+// ~ Writer of the raw samples of the runs
+// Workers fill blocks through TSampleStream, the full blocks are encoded and written
+// by a background thread, so the hot loop only appends to memory.
+class TSampleWriter {
+public:
+    // ~ Number of samples in a block
+    static constexpr ui64 BlockSamples = 1 << 16;
+    // ~ Number of blocks waiting to be written after which the workers wait for the writer
+    static constexpr ui64 MaxPendingBlocks = 64;
+
+public:
+    TSampleWriter(const std::string& path, const std::string& description);
+
+    TSampleWriter(const TSampleWriter&) = delete;
+
+    TSampleWriter& operator=(const TSampleWriter&) = delete;
+
+    // ~ Writes the pending blocks and closes the file
+    ~TSampleWriter();
+
+    // ~ Starts a run of the test with the given index and factor levels description
+    // Must not be called while the workers of the previous run collect samples.
+    void StartRun(ui32 test, const std::string& levels);
+
+    // ~ Returns the start of the current run
+    TTimePoint GetRunStart() const;
+
+    // ~ Returns an empty block with BlockSamples reserved
+    std::unique_ptr<TSampleBlock> AcquireBlock();
+
+    // ~ Queues the block to be written
+    void Submit(std::unique_ptr<TSampleBlock> block);
+
+private:
+    // ~ Loop of the background thread
+    void Work();
+
+    // ~ Waits until all the queued blocks are written
+    void Drain();
+
+    void WriteBlock(const TSampleBlock& block);
+
+    void WriteChunk(ESampleChunk type, const std::string& payload);
+
+    // ~ Writes the whole buffer, throws on errors
+    void WriteAll(const void* data, size_t size);
+
+private:
+    int Fd = -1;
+    ui32 Run = 0;
+    TTimePoint RunStart;
+
+    std::mutex Mutex;
+    std::condition_variable Changed;
+    std::deque<std::unique_ptr<TSampleBlock>> Pending;
+    // ~ Written blocks kept for reuse
+    std::vector<std::unique_ptr<TSampleBlock>> Free;
+    bool Writing = false;
+    bool Stopping = false;
+    // ~ Error of the background thread, rethrown to the workers
+    std::string Error;
+    std::thread Thread;
+
+    // ~ Encoding buffer of the background thread
+    std::string Buffer;
+};
+
+
+// ~ Collector of the raw samples of a single worker
+// Samples are added inside the timed batches, so Add() never waits or allocates: a full block is
+// swapped for the spare one and handed over to the writer by Handoff(), which the worker calls
+// between the batches. A block only grows past BlockSamples if it fills before the handoff.
+// The last block is submitted by Flush() and on destruction.
+class TSampleStream {
+public:
+    TSampleStream(TSampleWriter& writer, ui32 worker);
+
+    TSampleStream(const TSampleStream&) = delete;
+
+    TSampleStream& operator=(const TSampleStream&) = delete;
+
+    ~TSampleStream();
+
+    inline void Add(const TTimePoint& end, ui64 latency, off_t offset, bool isRead) {
+        Block->Samples.push_back({static_cast<ui64>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - RunStart).count()),
+                                  latency, static_cast<ui64>(offset), isRead ? 0u : 1u});
+        if (Block->Samples.size() >= TSampleWriter::BlockSamples && Spare) {
+            Full = std::move(Block);
+            Block = std::move(Spare);
+        }
+    }
+
+    // ~ Submits the full block to the writer and acquires a new spare one
+    // May wait for the writer, so it is called outside the timed regions.
+    inline void Handoff() {
+        if (Full)
+            SubmitFull();
+    }
+
+    // ~ Submits all the samples collected so far
+    void Flush();
+
+private:
+    void SubmitFull();
+
+    // ~ Returns an empty block of the worker
+    std::unique_ptr<TSampleBlock> Acquire();
+
+private:
+    TSampleWriter& Writer;
+    ui32 Worker;
+    TTimePoint RunStart;
+    // ~ Block being filled, the empty block replacing it once it is full and the full block
+    // Spare is empty only while Full waits for the handoff.
+    std::unique_ptr<TSampleBlock> Block;
+    std::unique_ptr<TSampleBlock> Spare;
+    std::unique_ptr<TSampleBlock> Full;
+};
+
+
+// ~ Read-only view of a samples file
+// The file is mapped and decoded block by block, so files larger than memory can be processed.
+class TSampleReader {
+public:
+    // ~ Run described by a run chunk
+    struct TRun {
+        ui32 Run = 0;
+        ui32 Test = 0;
+        // ~ Text of the run chunk
+        std::string Levels;
+    };
+
+    // ~ Samples of interest, the maximum value matches everything
+    struct TFilter {
+        ui32 Run = ~0u;
+        ui32 Test = ~0u;
+        ui32 Worker = ~0u;
+        ui32 Op = ~0u;
+    };
+
+public:
+    explicit TSampleReader(const std::string& path);
+
+    TSampleReader(const TSampleReader&) = delete;
+
+    TSampleReader& operator=(const TSampleReader&) = delete;
+
+    ~TSampleReader();
+
+    const std::string& GetDescription() const;
+
+    const std::vector<TRun>& GetRuns() const;
+
+    // ~ Calls visit for every sample matching the filter, in file order
+    void ForEach(const TFilter& filter, const std::function<void(ui32 worker, const TSample&)>& visit) const;
+
+    // ~ Returns the histogram of the latencies of the samples matching the filter (in nanoseconds)
+    // Percentiles are within 1% of the exact values (see THistogram).
+    THistogram Latencies(const TFilter& filter) const;
+
+private:
+    // ~ Calls visit for every samples chunk payload together with the test of its run
+    void ForEachBlock(const std::function<void(ui32 test, const TSampleBlockHeader&, const char* columns)>& visit) const;
+
+private:
+    void* Mapping = nullptr;
+    ui64 MappingSize = 0;
+    std::string Description;
+    std::vector<TRun> Runs;
+};
+
+
+
+
+
+
+#endif
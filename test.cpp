@@ -108,6 +108,124 @@ std::pair<ssize_t, ui64> TRandomLatencyAPI::Write(int fd, const std::vector<cons
 }
 
 
+ui32 TestHistogram() {
+    cout << "Histogram test. Values: {1, 2, ..., 100000} us." << endl;
+    THistogram histogram, other;
+    for (ui64 value = 1; value <= 100000; value++)
+        (value % 2 ? histogram : other).Add(value);
+    histogram.Merge(other);
+
+    ui32 failed = 0;
+    vector<pair<ld, ui64>> references = {{50, 50000}, {90, 90000}, {99, 99000}, {99.9, 99900}, {100, 100000}};
+    for (auto [percent, reference] : references) {
+        ui64 value = histogram.Percentile(percent);
+        cout << "p" << percent << ": " << value << " (reference: " << reference << ")" << endl;
+        // Buckets are less than 1% wide.
+        if (value < reference || value > reference * 1.01)
+            failed = 1;
+    }
+    if (histogram.GetCount() != 100000 || histogram.Statistics().first != 50000)
+        failed = 1;
+
+    cout << (failed ? "[X] Test failed." : "[✓] Test passed.") << endl;
+    return failed;
+}
+
+ui32 TestSteadyState() {
+    cout << "Steady state test. Rounds of 100 values." << endl;
+    ui32 failed = 0;
+
+    // A level series with periodic spikes is steady once the first 5 rounds are complete.
+    TSteadyStateDetector spiky(100, 0.15);
+    bool steady = false;
+    for (ui32 i = 0; i < 500; i++) {
+        steady = spiky.Add(i % 50 == 0 ? 1000 : 100);
+        if (steady && i < 499)
+            failed = 1;
+    }
+    cout << "Spikes: " << (steady ? "steady" : "not steady") << " (reference: steady)" << endl;
+    if (!steady)
+        failed = 1;
+
+    // A series rising by 3% per round never is: the range fits, the trend does not.
+    TSteadyStateDetector rising(100, 0.15);
+    steady = false;
+    for (ui32 i = 0; i < 5000; i++)
+        steady |= rising.Add(100 * powl(1.03, i / 100));
+    cout << "Trend: " << (steady ? "steady" : "not steady") << " (reference: not steady)" << endl;
+    if (steady)
+        failed = 1;
+
+    // The rounds slide: a level change in the middle of a round is left behind
+    // exactly 5 rounds after it, not at the next round boundary.
+    TSteadyStateDetector settling(100, 0.15);
+    ui32 settled = 0;
+    for (ui32 i = 0; i < 1000 && !settled; i++)
+        if (settling.Add(i < 250 ? 100000 : 100))
+            settled = i + 1;
+    cout << "Settling: steady after " << settled << " values (reference: 750)" << endl;
+    if (settled != 750)
+        failed = 1;
+
+    // The rolling window only covers the last values.
+    TRollingWindow window(4);
+    for (ld value : {100, 100, 1, 2, 3, 4})
+        window.Add(value);
+    if (fabsl(window.GetMean() - 2.5) > 1e-9 || fabsl(window.GetStd() - sqrtl(5.0 / 3)) > 1e-9)
+        failed = 1;
+
+    cout << (failed ? "[X] Test failed." : "[✓] Test passed.") << endl;
+    return failed;
+}
+
+ui32 TestHotLoop() {
+    cout << "Hot loop test. Mixed batches of 64 operations against the null engines (synchronous loops)." << endl;
+    const ui32 batchSize = 64;
+    const ui32 batches = 5000;
+    vector<char> buffer(4096);
+    vector<void*> bufs(batchSize, buffer.data());
+    vector<size_t> counts(batchSize, buffer.size());
+    vector<off_t> offsets(batchSize, 0);
+    vector<char> isRead(batchSize);
+    for (ui32 i = 0; i < batchSize; i++)
+        isRead[i] = (i % 2 == 0);
+
+    // The timed path is what reaches the latencies: the time inside the batches, per operation.
+    // The best of several repetitions is taken, so that a preemption does not decide the result.
+    THistogram opLatencies;
+    auto measure = [&](IAPI& api, THistogram* histogram) {
+        api.SetOpLatencies(histogram);
+        ld best = 0;
+        for (ui32 repetition = 0; repetition < 5; repetition++) {
+            ui64 busyTime = api.GetBusyTime();
+            for (ui32 batch = 0; batch < batches; batch++)
+                api.ReadWrite(-1, bufs, counts, offsets, isRead);
+            ld perOp = static_cast<ld>(api.GetBusyTime() - busyTime) / (batches * batchSize);
+            best = (repetition == 0 ? perOp : min(best, perOp));
+        }
+        api.SetOpLatencies(nullptr);
+        return best;
+    };
+
+    ui32 failed = 0;
+    TGenericNullAPI generic;
+    TNullAPI specialized;
+    for (THistogram* histogram : {static_cast<THistogram*>(nullptr), &opLatencies}) {
+        ld genericCost = measure(generic, histogram);
+        ld specializedCost = measure(specialized, histogram);
+        cout << (histogram ? "Measured operations" : "Batch only") << ": generic loop " << genericCost
+             << " ns, specialized loop " << specializedCost << " ns per operation" << endl;
+        // Without the timer reads the virtual calls dominate the generic loop. With them it reads the timer
+        // twice and updates the histogram per operation, the specialized one reads the timer once and
+        // records the operations after the batch. Both are well over the noise.
+        if (specializedCost * 1.5 > genericCost)
+            failed = 1;
+    }
+
+    cout << (failed ? "[X] Test failed." : "[✓] Test passed.") << endl;
+    return failed;
+}
+
 ui32 CompareResult(const std::vector<ui64>& result, ui64 refMean, ui64 refStd) {
     auto [mean, std] = Statistics(result);
     cout << "Reference mean: " << refMean << endl;
@@ -168,10 +286,10 @@ ui64 RandomLatencyStd(const std::vector<ui64>& latencies, ui32 batchSize) {
 void RunTests() {
     // ~ Test params
     TPattern pattern;
-    pattern.IsConsecutive = true;
-    pattern.IsRead = true;
+    pattern.ConsecutivePercent = 100;
+    pattern.ReadPercent = 100;
 
-    TFactorLevels factorLevels;
+    TFactorLevels factorLevels(pattern);
     factorLevels.RequestSize = 1_KB;
     factorLevels.QueueDepth = 1;
 
@@ -209,7 +327,18 @@ void RunTests() {
     }
     
 
+    // ~ Tests run and failed
+    ui32 tests = 0;
     ui32 failed = 0;
+    auto check = [&](ui32 result) {
+        tests++;
+        failed += result;
+    };
+
+    check(TestHistogram());
+    check(TestSteadyState());
+    check(TestHotLoop());
+    cout << endl;
     for (ui32 i = 0; i < sizes; i++) {
         cout << "-----------------------------------" << endl;
         cout << "Testing with batch size: " << batchSizes[i] << endl;
@@ -218,24 +347,24 @@ void RunTests() {
         cout << "Fixed latency test. Latency: 15 us." << endl;
         TAPIFactory<TFixedLatencyAPI> fixedFactory;
         TBenchmark fixedBenchmark(pattern, factorLevels, warmup, environment, testDuration, batchSizes[i], &fixedFactory);
-        failed += CompareResult(fixedBenchmark.Benchmark(), fixedLatencyMean[i], fixedLatencyStd[i]);
+        check(CompareResult(fixedBenchmark.Benchmark().Workers[0].Latencies, fixedLatencyMean[i], fixedLatencyStd[i]));
         cout << endl;
 
         cout << "Switching latency test. Latencies: {20 us, 30 us, 40 us}." << endl;
         TAPIFactory<TSwitchingLatencyAPI> switchingFactory;
         TBenchmark switchingBenchmark(pattern, factorLevels, warmup, environment, testDuration, batchSizes[i], &switchingFactory);    
-        failed += CompareResult(switchingBenchmark.Benchmark(), switchingLatencyMean[i], switchingLatencyStd[i]);
+        check(CompareResult(switchingBenchmark.Benchmark().Workers[0].Latencies, switchingLatencyMean[i], switchingLatencyStd[i]));
         cout << endl;
 
         cout << "Random latency test. Latencies: {10 us, 20 us, 60 us}." << endl;
         TAPIFactory<TRandomLatencyAPI> randomFactory;
         TBenchmark randomBenchmark(pattern, factorLevels, warmup, environment, testDuration, batchSizes[i], &randomFactory);
-        failed += CompareResult(randomBenchmark.Benchmark(), randomLatencyMean[i], randomLatencyStd[i]);
+        check(CompareResult(randomBenchmark.Benchmark().Workers[0].Latencies, randomLatencyMean[i], randomLatencyStd[i]));
         cout << endl;
 
         cout << endl;
     }
-    cout << "Test passed: " << (sizes * 3 - failed) << "/" << (sizes * 3) << endl;
+    cout << "Test passed: " << (tests - failed) << "/" << tests << endl;
     if (failed == 0)
         cout << "Success." << endl;
     else
@@ -77,6 +77,27 @@ private:
 };
 
 
+// ~ Null API going through the generic IAPI batch loops (virtual base operations)
+// Baseline of the hot loop microbenchmark against TNullAPI.
+class TGenericNullAPI : public IAPI {
+private:
+    virtual ssize_t pread(int fd, void* buf, size_t count, off_t offset) override { return count; }
+
+    virtual ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) override { return count; }
+
+    virtual ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) override { return iov[0].iov_len * iovcnt; }
+
+    virtual ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) override { return iov[0].iov_len * iovcnt; }
+};
+
+
+ui32 TestHistogram();
+
+ui32 TestSteadyState();
+
+// ~ Microbenchmark of the batch loops: time per operation of TNullAPI against TGenericNullAPI
+ui32 TestHotLoop();
+
 ui32 CompareResult(const std::vector<ui64>& result, ui64 refMean, ui64 refStd);
 
 ui64 RandomLatencyStd(const std::vector<ui64>& latencies, ui32 batchSize);
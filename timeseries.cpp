@@ -0,0 +1,60 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __TIMESERIES__CPP__
+#define __TIMESERIES__CPP__
+
+
+#include "timeseries.h"
+
+#include <stdexcept> // runtime_error
+#include <algorithm> // std::max()
+
+
+TTimeSeriesWriter::TTimeSeriesWriter(const std::string& path, ui64 interval)
+    : Interval(interval) {
+    if (interval == 0)
+        throw std::runtime_error("TTimeSeriesWriter() error: interval must be positive");
+    File = fopen(path.c_str(), "w");
+    if (!File)
+        throw std::runtime_error("Couldn't not open time series file \"" + path + "\"");
+    fprintf(File, "run,test,worker,start_us,duration_us,bytes,ops,throughput_Bps,iops,"
+                  "p50_us,p90_us,p99_us,p999_us,max_us\n");
+    fflush(File);
+}
+
+TTimeSeriesWriter::~TTimeSeriesWriter() {
+    if (File)
+        fclose(File);
+}
+
+ui64 TTimeSeriesWriter::GetInterval() const {
+    return Interval;
+}
+
+void TTimeSeriesWriter::StartRun(ui32 test) {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Run++;
+    Test = test;
+}
+
+void TTimeSeriesWriter::Write(const TIntervalRecord& record) {
+    const THistogram& latencies = *record.OpLatencies;
+    ui64 duration = std::max<ui64>(record.Duration, 1);
+    ui64 throughput = (ld)record.Bytes * 1_s / duration;
+    ui64 iops = (ld)latencies.GetCount() * 1_s / duration;
+
+    std::lock_guard<std::mutex> lock(Mutex);
+    fprintf(File, "%u,%u,%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+            Run, Test, record.Worker, (ull)record.Start, (ull)record.Duration,
+            (ull)record.Bytes, (ull)latencies.GetCount(), (ull)throughput, (ull)iops,
+            (ull)latencies.Percentile(50), (ull)latencies.Percentile(90), (ull)latencies.Percentile(99),
+            (ull)latencies.Percentile(99.9), (ull)latencies.GetMax());
+    fflush(File);
+}
+
+
+
+
+
+
+#endif
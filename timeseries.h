@@ -0,0 +1,64 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __TIMESERIES__H__
+#define __TIMESERIES__H__
+
+
+#include "globals.h"
+#include "histogram.h"
+
+#include <string>
+#include <mutex>
+#include <cstdio> // FILE
+
+
+// ~ Statistics of a single worker over a single interval of a run
+struct TIntervalRecord {
+    ui32 Worker = 0;
+    // ~ Start of the interval since the end of the warmup and its duration (in microseconds)
+    ui64 Start = 0;
+    ui64 Duration = 0;
+    // ~ Amount of bytes requested during the interval
+    ui64 Bytes = 0;
+    // ~ Latencies of the operations completed during the interval
+    const THistogram* OpLatencies = nullptr;
+};
+
+
+// ~ Writer of the per-interval time series of the runs
+// Records are written as CSV lines as soon as they are received and flushed,
+// so that the series can be watched while an experiment is running.
+// Thread-safe: workers write their records concurrently.
+class TTimeSeriesWriter {
+public:
+    TTimeSeriesWriter(const std::string& path, ui64 interval);
+
+    TTimeSeriesWriter(const TTimeSeriesWriter&) = delete;
+
+    TTimeSeriesWriter& operator=(const TTimeSeriesWriter&) = delete;
+
+    ~TTimeSeriesWriter();
+
+    // ~ Returns the interval length (in microseconds)
+    ui64 GetInterval() const;
+
+    // ~ Marks the beginning of a run of the test with the given index
+    void StartRun(ui32 test);
+
+    void Write(const TIntervalRecord& record);
+
+private:
+    std::mutex Mutex;
+    FILE* File = nullptr;
+    ui64 Interval;
+    // ~ Number of the current run and index of its test
+    ui32 Run = 0;
+    ui32 Test = 0;
+};
+
+
+
+
+
+
+#endif
@@ -0,0 +1,85 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __TRACE__CPP__
+#define __TRACE__CPP__
+
+
+#include "trace.h"
+
+#include <sys/mman.h> // mmap(), munmap(), madvise()
+#include <sys/stat.h> // fstat()
+#include <fcntl.h> // open()
+#include <unistd.h> // close(), sysconf()
+#include <cerrno> // errno
+#include <cstring> // memcmp(), strerror()
+#include <stdexcept> // runtime_error
+
+
+TTraceReader::TTraceReader(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error("Couldn't not open trace \"" + path + "\"");
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (ui64)st.st_size < sizeof(TTraceHeader)) {
+        close(fd);
+        throw std::runtime_error("Trace \"" + path + "\" is too short");
+    }
+
+    MappingSize = st.st_size;
+    Mapping = mmap(nullptr, MappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (Mapping == MAP_FAILED) {
+        Mapping = nullptr;
+        throw std::runtime_error(std::string("TTraceReader() mmap() error: ") + strerror(errno));
+    }
+    // The records are read once in order.
+    madvise(Mapping, MappingSize, MADV_SEQUENTIAL);
+
+    Header = static_cast<const TTraceHeader*>(Mapping);
+    Records = reinterpret_cast<const TTraceRecord*>(Header + 1);
+    if (memcmp(Header->Magic, TraceMagic, sizeof(TraceMagic)) != 0
+        || Header->Count > (MappingSize - sizeof(TTraceHeader)) / sizeof(TTraceRecord)) {
+        munmap(Mapping, MappingSize);
+        Mapping = nullptr;
+        throw std::runtime_error("\"" + path + "\" is not a valid trace");
+    }
+
+    // The replay waits for each timestamp, a decreasing one would make it wait for a wrapped around time.
+    for (ui64 i = 1; i < Header->Count; i++)
+        if (Records[i].Timestamp < Records[i - 1].Timestamp) {
+            munmap(Mapping, MappingSize);
+            Mapping = nullptr;
+            throw std::runtime_error("TTraceReader() error: timestamp of record " + std::to_string(i) +
+                                     " of \"" + path + "\" precedes the previous one");
+        }
+    // The scan should not keep a trace larger than memory resident.
+    Release(Header->Count);
+}
+
+TTraceReader::~TTraceReader() {
+    if (Mapping)
+        munmap(Mapping, MappingSize);
+}
+
+ui64 TTraceReader::GetCount() const {
+    return Header->Count;
+}
+
+ui64 TTraceReader::GetMaxSize() const {
+    return Header->MaxSize;
+}
+
+void TTraceReader::Release(ui64 index) const {
+    ui64 pageSize = sysconf(_SC_PAGESIZE);
+    ui64 end = sizeof(TTraceHeader) + index * sizeof(TTraceRecord);
+    end -= end % pageSize;
+    if (end > 0)
+        madvise(Mapping, end, MADV_DONTNEED);
+}
+
+
+
+
+
+
+#endif
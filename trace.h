@@ -0,0 +1,84 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __TRACE__H__
+#define __TRACE__H__
+
+
+#include "globals.h"
+
+#include <string>
+
+
+// ~ Magic bytes starting a trace file
+constexpr char TraceMagic[8] = {'I', 'O', 'T', 'R', 'A', 'C', 'E', '1'};
+
+
+// ~ Header of a trace file
+// The file is the header followed by Count records, all the fields are little-endian.
+struct TTraceHeader {
+    char Magic[8];
+    // ~ Number of records
+    ui64 Count;
+    // ~ Maximum operation size among the records (in bytes)
+    ui64 MaxSize;
+};
+
+
+// ~ Operations of trace records
+enum class ETraceOp : ui32 {
+    Read = 0,
+    Write = 1,
+};
+
+
+// ~ Single request of a trace
+struct TTraceRecord {
+    // ~ Time since the start of the trace (in nanoseconds), non-decreasing
+    ui64 Timestamp;
+    // ~ File offset and size of the operation (in bytes)
+    ui64 Offset;
+    ui32 Size;
+    // ~ Operation (see ETraceOp)
+    ui32 Op;
+};
+
+static_assert(sizeof(TTraceHeader) == 24 && sizeof(TTraceRecord) == 24, "Trace layout must not be padded");
+
+
+// ~ Read-only view of a trace file
+// The file is mapped rather than read, so traces larger than memory can be replayed.
+class TTraceReader {
+public:
+    explicit TTraceReader(const std::string& path);
+
+    TTraceReader(const TTraceReader&) = delete;
+
+    TTraceReader& operator=(const TTraceReader&) = delete;
+
+    ~TTraceReader();
+
+    ui64 GetCount() const;
+
+    ui64 GetMaxSize() const;
+
+    inline const TTraceRecord& operator[](ui64 index) const {
+        return Records[index];
+    }
+
+    // ~ Drops the already replayed pages preceding the record at index from memory
+    // The pages are read from the file again if accessed later.
+    void Release(ui64 index) const;
+
+private:
+    void* Mapping = nullptr;
+    ui64 MappingSize = 0;
+    const TTraceHeader* Header = nullptr;
+    const TTraceRecord* Records = nullptr;
+};
+
+
+
+
+
+
+#endif
@@ -3,17 +3,44 @@
 
 class Pattern:
     def __init__(self):
-        self.is_consecutive = 0 
-        self.is_read = 0 
+        self.consecutive_percent = 0
+        self.read_percent = 0
 
 class Throughput:
     def __init__(self):
         self.mean = 0 
         self.std = 0 
+        self.ci = 0
+
+class Latency:
+    def __init__(self):
+        self.mean = 0
+        self.std = 0
+        self.p50 = 0
+        self.p90 = 0
+        self.p99 = 0
+        self.p999 = 0
+        self.max = 0
+
+class Flush:
+    def __init__(self):
+        self.count = 0
+        self.mean = 0
+        self.std = 0
+        self.p99 = 0
+        self.max = 0
 
 class Measurement:
     def __init__(self):
         self.throughput = Throughput()
+        self.latency = Latency()
+        self.fairness = 1.0
+        self.minor_faults = 0
+        self.major_faults = 0
+        self.resident = 0.0
+        self.would_block = 0
+        self.flush = Flush()
+        self.harness_overhead = 0
         self.factors = dict()
 
 class Result:
@@ -23,8 +50,8 @@ class Result:
 
 def parse_pattern(f):
     pattern = Pattern()
-    pattern.is_consecutive = int(f.readline())
-    pattern.is_read = int(f.readline())
+    pattern.consecutive_percent = int(f.readline())
+    pattern.read_percent = int(f.readline())
     return pattern
 
 
@@ -38,15 +65,46 @@ def parse_throughput(f):
     throughput = Throughput()
     throughput.mean = int(f.readline())
     throughput.std = int(f.readline())
+    throughput.ci = int(f.readline())
     return throughput
 
 
+def parse_latency(f):
+    latency = Latency()
+    latency.mean = int(f.readline())
+    latency.std = int(f.readline())
+    latency.p50 = int(f.readline())
+    latency.p90 = int(f.readline())
+    latency.p99 = int(f.readline())
+    latency.p999 = int(f.readline())
+    latency.max = int(f.readline())
+    return latency
+
+
+def parse_flush(f):
+    flush = Flush()
+    flush.count = int(f.readline())
+    flush.mean = int(f.readline())
+    flush.std = int(f.readline())
+    flush.p99 = int(f.readline())
+    flush.max = int(f.readline())
+    return flush
+
+
 def parse_measurement(f, factorsCnt):
     measurement = Measurement()
     for i in range(factorsCnt):
         factor, level = parse_factor(f)
         measurement.factors[factor] = level
     measurement.throughput = parse_throughput(f)
+    measurement.latency = parse_latency(f)
+    measurement.fairness = float(f.readline())
+    measurement.minor_faults = int(f.readline())
+    measurement.major_faults = int(f.readline())
+    measurement.resident = float(f.readline())
+    measurement.would_block = int(f.readline())
+    measurement.flush = parse_flush(f)
+    measurement.harness_overhead = int(f.readline())
     return measurement
 
 
@@ -99,7 +99,7 @@ def plot_2d_bars(result):
     ax.bar(x, dy, dx, color=color, align='edge')
 
     pattern = result.pattern;
-    title = "IsConsecutive: {}, IsRead: {}\nMetric: {}".format(pattern.is_consecutive, pattern.is_read, "Throughput")
+    title = "Consecutive: {}%, Read: {}%\nMetric: {}".format(pattern.consecutive_percent, pattern.read_percent, "Throughput")
 
     ax.set_title(title)
     ax.set_xlabel(key)
@@ -211,7 +211,7 @@ def plot_3d_bars(result):
     ax.bar3d(x, y, z, dx, dy, dz, color=color, shade=True)
 
     pattern = result.pattern;
-    title = "IsConsecutive: {}, IsRead: {}\nMetric: {}".format(pattern.is_consecutive, pattern.is_read, "Throughput")
+    title = "Consecutive: {}%, Read: {}%\nMetric: {}".format(pattern.consecutive_percent, pattern.read_percent, "Throughput")
 
     ax.set_title(title)
     ax.set_xlabel(keys[0])
@@ -0,0 +1,114 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __WAL__CPP__
+#define __WAL__CPP__
+
+
+#include "wal.h"
+
+#include <sys/stat.h> // open flags
+#include <fcntl.h> // open(), fallocate()
+#include <unistd.h> // fdatasync(), close(), unlink()
+#include <cerrno> // errno
+#include <cstring> // strerror()
+#include <stdexcept> // runtime_error
+#include <string> // std::to_string()
+#include <algorithm> // std::max()
+
+
+TGroupCommit::TGroupCommit(const std::string& path, EWalMode mode, ui64 capacity, bool preallocate, bool directIO,
+                           ui32 producers, ui32 group)
+    : Path(path)
+    , Mode(mode)
+    , Capacity(capacity)
+    , Group(std::max<ui32>(group, 1))
+    , Active(producers) {
+    if (mode != EWalMode::Reserved && mode != EWalMode::Append)
+        throw std::runtime_error("TGroupCommit() error: WAL mode " + std::to_string(static_cast<ui32>(mode)) +
+                                 " not supported");
+    int flags = O_RDWR | O_CREAT | O_TRUNC | (mode == EWalMode::Append ? O_APPEND : 0);
+    #if defined (__linux__)
+    if (directIO)
+        flags |= O_DIRECT;
+    #endif
+    if ((Fd = open(path.c_str(), flags, S_IRWXU)) == -1)
+        throw std::runtime_error("TGroupCommit() error: couldn't create log \"" + path + "\": " + strerror(errno));
+
+    // Appends to a preallocated log do not change the allocation, only the size in the Append mode.
+    if (preallocate) {
+        int result = -1;
+        #if defined (__linux__)
+        result = fallocate(Fd, mode == EWalMode::Append ? FALLOC_FL_KEEP_SIZE : 0, 0, capacity);
+        #else
+        if (mode == EWalMode::Reserved)
+            result = posix_fallocate(Fd, 0, capacity);
+        #endif
+        if (result != 0 || fdatasync(Fd) == -1) {
+            close(Fd);
+            unlink(path.c_str());
+            throw std::runtime_error("TGroupCommit() error: couldn't preallocate log \"" + path + "\"");
+        }
+    }
+}
+
+TGroupCommit::~TGroupCommit() {
+    close(Fd);
+    unlink(Path.c_str());
+}
+
+int TGroupCommit::GetFd() const {
+    return Fd;
+}
+
+off_t TGroupCommit::Reserve(ui64 size) {
+    ui64 offset = Tail.fetch_add(size);
+    // The records of a reused log keep their alignment.
+    ui64 capacity = Capacity - Capacity % size;
+    return (capacity >= size ? offset % capacity : offset);
+}
+
+void TGroupCommit::Commit(THistogram* flushLatencies) {
+    std::unique_lock<std::mutex> lock(Mutex);
+    ui64 record = ++Appended;
+    Waiting++;
+    while (Durable < record && Error == 0) {
+        if (Flushing || (Appended - Durable < Group && Waiting < Active)) {
+            Committed.wait(lock);
+            continue;
+        }
+
+        // The caller leads the flush of all the records appended so far.
+        Flushing = true;
+        ui64 target = Appended;
+        lock.unlock();
+        auto start = Nhrc::now();
+        int error = (fdatasync(Fd) == -1 ? errno : 0);
+        ui64 latency = Duration(start, Nhrc::now());
+        lock.lock();
+        Flushing = false;
+        if (error == 0) {
+            Durable = std::max(Durable, target);
+            if (flushLatencies)
+                flushLatencies->Add(latency);
+        } else {
+            Error = error;
+        }
+        Committed.notify_all();
+    }
+    Waiting--;
+    if (Error != 0)
+        throw std::runtime_error(std::string("TGroupCommit::Commit() fdatasync() error: ") + strerror(Error));
+}
+
+void TGroupCommit::Leave() {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Active--;
+    Committed.notify_all();
+}
+
+
+
+
+
+
+#endif
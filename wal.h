@@ -0,0 +1,82 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __WAL__H__
+#define __WAL__H__
+
+
+#include "globals.h"
+#include "histogram.h"
+
+#include <sys/types.h> // off_t
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+
+// ~ Modes of the append workload selectable through the "WAL" factor
+enum class EWalMode : ui32 {
+    // ~ The workload is given by the pattern
+    Off = 0,
+    // ~ Records are written at offsets reserved by the producers, the log is reused once full
+    Reserved = 1,
+    // ~ The log is opened with O_APPEND and grows for the whole run
+    Append = 2,
+};
+
+
+// ~ Log file shared by the producers of the append workload
+// A producer appends a record and waits in Commit() until a flush (fdatasync()) covers it.
+// The flush is made by one of the waiting producers (the leader) once group records are
+// pending or all the active producers are waiting, the records of the others are committed with it.
+// The log is created empty and removed when the object is destroyed.
+class TGroupCommit {
+public:
+    TGroupCommit(const std::string& path, EWalMode mode, ui64 capacity, bool preallocate, bool directIO,
+                 ui32 producers, ui32 group);
+
+    TGroupCommit(const TGroupCommit&) = delete;
+
+    TGroupCommit& operator=(const TGroupCommit&) = delete;
+
+    ~TGroupCommit();
+
+    int GetFd() const;
+
+    // ~ Reserves size bytes of the log and returns their offset (ignored in the Append mode)
+    off_t Reserve(ui64 size);
+
+    // ~ Waits until the record appended by the caller is durable
+    // The latency of a flush made by the caller is added to flushLatencies (if set).
+    void Commit(THistogram* flushLatencies);
+
+    // ~ Removes the caller from the producers, so that the others do not wait for it
+    void Leave();
+
+private:
+    std::string Path;
+    EWalMode Mode;
+    ui64 Capacity;
+    int Fd = -1;
+    ui32 Group;
+    // ~ Next offset to be reserved (grows without wrapping)
+    std::atomic<ui64> Tail{0};
+
+    std::mutex Mutex;
+    std::condition_variable Committed;
+    // ~ Records appended and records made durable so far
+    ui64 Appended = 0;
+    ui64 Durable = 0;
+    ui32 Active;
+    ui32 Waiting = 0;
+    bool Flushing = false;
+    // ~ errno of a failed flush (0 if none failed)
+    int Error = 0;
+};
+
+
+
+
+
+
+#endif
@@ -0,0 +1,94 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __WARMUP__CPP__
+#define __WARMUP__CPP__
+
+
+#include "warmup.h"
+
+#include <cmath> // sqrtl(), fabsl()
+#include <algorithm> // std::min(), std::max()
+#include <stdexcept> // runtime_error
+#include <utility> // std::move()
+
+
+TRollingWindow::TRollingWindow(ui32 capacity)
+    : Values(capacity) {
+    if (capacity == 0)
+        throw std::runtime_error("TRollingWindow() error: capacity must be positive");
+}
+
+ld TRollingWindow::GetStd() const {
+    return (Size > 1 ? sqrtl(M2 / (Size - 1)) : 0);
+}
+
+
+TSteadyStateDetector::TSteadyStateDetector(ui32 window, double rangeCoef)
+    : RoundWindows(Rounds, TRollingWindow(window))
+    , RangeCoef(rangeCoef) {}
+
+bool TSteadyStateDetector::CheckRounds() const {
+    std::array<ld, Rounds> means;
+    for (ui32 i = 0; i < Rounds; i++)
+        means[i] = RoundWindows[i].GetMean();
+
+    ld average = 0;
+    ld minimum = means[0];
+    ld maximum = means[0];
+    for (ld mean : means) {
+        average += mean / Rounds;
+        minimum = std::min(minimum, mean);
+        maximum = std::max(maximum, mean);
+    }
+    if (maximum - minimum > RangeCoef * average)
+        return false;
+
+    // Slope of the least squares line through (i, means[i]), the trend is its change across the rounds.
+    ld center = (Rounds - 1) / 2.0;
+    ld covariance = 0;
+    ld variance = 0;
+    for (ui32 i = 0; i < Rounds; i++) {
+        covariance += (i - center) * (means[i] - average);
+        variance += (i - center) * (i - center);
+    }
+    ld trend = covariance / variance * (Rounds - 1);
+    return fabsl(trend) <= RangeCoef / 2 * average;
+}
+
+TMeasurementBarrier::TMeasurementBarrier(ui32 workers, std::function<void()> action)
+    : Workers(workers)
+    , Action(std::move(action)) {}
+
+void TMeasurementBarrier::Arrive() {
+    std::unique_lock<std::mutex> lock(Mutex);
+    if (++Arrived + Left < Workers) {
+        Passed.wait(lock, [this]() { return Released; });
+        return;
+    }
+    // The others wait for the action whichever way it finishes.
+    struct TRelease {
+        TMeasurementBarrier& Barrier;
+        ~TRelease() {
+            Barrier.Released = true;
+            Barrier.Passed.notify_all();
+        }
+    } release{*this};
+    if (Action)
+        Action();
+}
+
+void TMeasurementBarrier::Leave() {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Left++;
+    if (!Released && Arrived + Left >= Workers) {
+        Released = true;
+        Passed.notify_all();
+    }
+}
+
+
+
+
+
+
+#endif
@@ -0,0 +1,137 @@
+/* Copyright © 2021 Vladimir Erofeev. All rights reserved. */
+
+#ifndef __WARMUP__H__
+#define __WARMUP__H__
+
+
+#include "globals.h"
+
+#include <vector>
+#include <array>
+#include <functional> // std::function
+#include <mutex>
+#include <condition_variable>
+
+
+// ~ Mean and variance of the last Capacity values added
+// Values are kept in a ring buffer and the statistics are updated by Welford's method
+// for a sliding window, so adding a value takes O(1) and never allocates.
+class TRollingWindow {
+public:
+    explicit TRollingWindow(ui32 capacity);
+
+    inline void Add(ld value) {
+        if (Size < Values.size()) {
+            Values[Size++] = value;
+            ld delta = value - Mean;
+            Mean += delta / Size;
+            M2 += delta * (value - Mean);
+            return;
+        }
+        // The oldest value is replaced by the new one.
+        ld old = Values[Position];
+        Values[Position] = value;
+        Position = (Position + 1 == Values.size() ? 0 : Position + 1);
+        ld mean = Mean + (value - old) / Size;
+        M2 += (value - old) * (value - mean + old - Mean);
+        if (M2 < 0)
+            M2 = 0;
+        Mean = mean;
+    }
+
+    bool IsFull() const { return Size == Values.size(); }
+
+    // ~ Returns the value the next Add() replaces, valid once the window is full
+    ld GetOldest() const { return Values[Position]; }
+
+    ld GetMean() const { return Mean; }
+
+    ld GetStd() const;
+
+private:
+    std::vector<ld> Values;
+    ui32 Size = 0;
+    // ~ Index of the oldest value once the window is full
+    ui32 Position = 0;
+    ld Mean = 0;
+    // ~ Sum of squared deviations from the mean
+    ld M2 = 0;
+};
+
+
+// ~ Detector of the steady state of a series of batch latencies
+// SNIA PTS style: the last Rounds * window values are cut into rounds of window values, the state
+// is steady when the means of the rounds stay within the range of rangeCoef times their average
+// and the least squares trend across them changes by at most half of that.
+// The rounds slide with every value: a value leaving a round enters the preceding one, so the
+// state is checked after each value rather than at round boundaries only.
+// Unlike the std <= coef * mean criterion, periodic spikes (e.g. garbage collection of a device)
+// inside the rounds do not prevent it, while a drift across the rounds does.
+class TSteadyStateDetector {
+public:
+    // ~ Number of round means compared
+    static constexpr ui32 Rounds = 5;
+
+public:
+    TSteadyStateDetector(ui32 window, double rangeCoef);
+
+    // ~ Adds a value and returns true if the state is steady
+    inline bool Add(ld value) {
+        // Rounds are ordered from the oldest to the newest one.
+        for (ui32 i = Rounds; i-- > 0;) {
+            bool full = RoundWindows[i].IsFull();
+            ld oldest = (full ? RoundWindows[i].GetOldest() : 0);
+            RoundWindows[i].Add(value);
+            // The older rounds are still empty unless the oldest one has just been filled.
+            if (!full)
+                return i == 0 && RoundWindows[0].IsFull() && CheckRounds();
+            value = oldest;
+        }
+        return CheckRounds();
+    }
+
+    // ~ Returns the mean and the std of the last window values
+    ld GetMean() const { return RoundWindows[Rounds - 1].GetMean(); }
+
+    ld GetStd() const { return RoundWindows[Rounds - 1].GetStd(); }
+
+private:
+    // ~ Checks the range and the trend of the last round means
+    bool CheckRounds() const;
+
+private:
+    std::vector<TRollingWindow> RoundWindows;
+    double RangeCoef;
+};
+
+// ~ Barrier the workers pass between their warmup and their measurement
+// The last worker to arrive runs the action (e.g. sets the state the measurement starts from)
+// before any of them is released. A worker leaving before it arrives (e.g. on an error)
+// releases the others without the action, so that they are not blocked by it.
+class TMeasurementBarrier {
+public:
+    TMeasurementBarrier(ui32 workers, std::function<void()> action);
+
+    // ~ Waits until all the workers have arrived and the action has run
+    // The exception of a failed action is thrown to the worker which ran it, the others are released.
+    void Arrive();
+
+    // ~ Removes the caller from the workers, has no effect once they are released
+    void Leave();
+
+private:
+    ui32 Workers;
+    std::function<void()> Action;
+    std::mutex Mutex;
+    std::condition_variable Passed;
+    ui32 Arrived = 0;
+    ui32 Left = 0;
+    bool Released = false;
+};
+
+
+
+
+
+
+#endif